@@ -0,0 +1,110 @@
+#include "FBXDocument.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Compares the ASCII FBX reader against a straightforward strtod based
+// reader of the same array blocks and, when given, the binary reader on
+// the same scene saved as binary.
+//
+// Usage: AsciiReaderBenchmark <ascii.fbx> [binary.fbx] [repeats]
+
+namespace {
+    template<typename Function>
+    double timeMilliseconds(int repeats, Function function) {
+        // Take the best run to reduce noise from the page cache and other processes
+        double best = 1e30;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    /// <summary>
+    /// Parses every "a:" array block with strtod one character scan at a time
+    /// </summary>
+    size_t parseArraysWithStrtod(const std::string& text, std::vector<double>& values) {
+        values.clear();
+
+        size_t position = 0;
+        while ((position = text.find("a:", position)) != std::string::npos) {
+            const char* current = text.c_str() + position + 2;
+            while (*current != '}' && *current != '\0') {
+                if (*current == ',' || *current == ' ' || *current == '\t' || *current == '\r' || *current == '\n') {
+                    current++;
+                    continue;
+                }
+                char* numberEnd;
+                double value = std::strtod(current, &numberEnd);
+                if (numberEnd == current) {
+                    break;
+                }
+                values.push_back(value);
+                current = numberEnd;
+            }
+            position = current - text.c_str();
+        }
+        return values.size();
+    }
+
+    size_t countArrayElements(const std::vector<fbx::Node>& nodes) {
+        size_t count = 0;
+        for (const fbx::Node& node : nodes) {
+            for (const fbx::Property& property : node.properties) {
+                if (property.isArray()) {
+                    count += property.arrayCount;
+                }
+            }
+            count += countArrayElements(node.children);
+        }
+        return count;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: AsciiReaderBenchmark <ascii.fbx> [binary.fbx] [repeats]" << std::endl;
+        return 1;
+    }
+    const char* asciiFile = argv[1];
+    const char* binaryFile = argc > 2 ? argv[2] : nullptr;
+    int repeats = argc > 3 ? std::max(1, std::atoi(argv[3])) : 5;
+
+    fbx::MappedFile file(asciiFile);
+    double megabytes = file.size() / (1024.0 * 1024.0);
+
+    size_t readerElements = 0;
+    double readerTime = timeMilliseconds(repeats, [&]() {
+        fbx::Document document = fbx::readAsciiDocument(asciiFile);
+        readerElements = countArrayElements(document.nodes);
+    });
+
+    // strtod needs a terminated string, the copy is made outside the timed runs
+    std::string text(file.data(), file.size());
+    std::vector<double> values;
+    size_t strtodElements = 0;
+    double strtodTime = timeMilliseconds(repeats, [&]() {
+        strtodElements = parseArraysWithStrtod(text, values);
+    });
+
+    std::cout << "File size: " << megabytes << " MB, array elements: " << readerElements << std::endl;
+    std::cout << "ASCII reader (whole document): " << readerTime << " ms, " << megabytes / (readerTime / 1000) << " MB/s" << std::endl;
+    std::cout << "strtod arrays only:            " << strtodTime << " ms, " << megabytes / (strtodTime / 1000) << " MB/s"
+        << " (" << strtodElements << " elements)" << std::endl;
+
+    if (binaryFile != nullptr) {
+        double binaryTime = timeMilliseconds(repeats, [&]() {
+            fbx::Document document = fbx::readBinaryDocument(binaryFile);
+        });
+        std::cout << "Binary reader (same scene):    " << binaryTime << " ms" << std::endl;
+    }
+
+    return 0;
+}
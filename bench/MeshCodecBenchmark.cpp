@@ -0,0 +1,88 @@
+#include "FBXMeshCodec.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// Encodes every mesh of a scene with and without the entropy stage and
+// times decoding, against copying the uncompressed streams.
+//
+// Usage: MeshCodecBenchmark <file.fbx> [repeats]
+
+namespace {
+    template<typename Function>
+    double timeMilliseconds(int repeats, Function function) {
+        // Take the best run to reduce noise from other processes
+        double best = 1e30;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    size_t getMeshBytes(const fbx::Mesh& mesh) {
+        return mesh.vertexPositions.size() * sizeof(glm::vec3)
+            + mesh.vertexTextureCoords.size() * sizeof(glm::vec2)
+            + mesh.vertexNormals.size() * sizeof(glm::vec3)
+            + mesh.vertexTangents.size() * sizeof(glm::vec4)
+            + mesh.vertexMaterialIDs.size() * sizeof(uint32_t)
+            + mesh.vertexIndices.size() * sizeof(uint32_t);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: MeshCodecBenchmark <file.fbx> [repeats]" << std::endl;
+        return 1;
+    }
+    int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    fbx::Scene scene = fbx::loadFBXFile(argv[1]);
+
+    size_t rawBytes = 0;
+    for (const fbx::Mesh& mesh : scene.meshes) {
+        rawBytes += getMeshBytes(mesh);
+    }
+
+    for (bool entropyCoding : { false, true }) {
+        std::vector<std::vector<char>> encoded;
+        double encodeTime = timeMilliseconds(1, [&]() {
+            encoded.clear();
+            for (const fbx::Mesh& mesh : scene.meshes) {
+                encoded.emplace_back(fbx::encodeMesh(mesh, entropyCoding));
+            }
+        });
+
+        size_t encodedBytes = 0;
+        for (const std::vector<char>& buffer : encoded) {
+            encodedBytes += buffer.size();
+        }
+
+        double decodeTime = timeMilliseconds(repeats, [&]() {
+            for (const std::vector<char>& buffer : encoded) {
+                fbx::Mesh mesh = fbx::decodeMesh(buffer.data(), buffer.size());
+            }
+        });
+
+        std::cout << (entropyCoding ? "Byte planes + deflate: " : "Byte planes:           ")
+            << encodedBytes / (1024.0 * 1024.0) << " MB (" << 100.0 * encodedBytes / rawBytes << "% of "
+            << rawBytes / (1024.0 * 1024.0) << " MB), encode " << encodeTime << " ms, decode " << decodeTime << " ms ("
+            << rawBytes / (decodeTime * 1e6) << " GB/s)" << std::endl;
+    }
+
+    // Copying the streams is the cost of reading them uncompressed from memory
+    double copyTime = timeMilliseconds(repeats, [&]() {
+        for (const fbx::Mesh& mesh : scene.meshes) {
+            fbx::Mesh copy = mesh;
+        }
+    });
+    std::cout << "Uncompressed copy:     " << copyTime << " ms (" << rawBytes / (copyTime * 1e6) << " GB/s)" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "FBXTransform.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "gtc/matrix_transform.hpp"
+
+// Transforms a batch of points with each kernel the CPU supports and
+// compares them with the per vertex glm mat4 * vec4 path of the loader.
+//
+// Usage: TransformBenchmark [points] [repeats]
+
+namespace {
+    template<typename Function>
+    double timeMilliseconds(int repeats, Function function) {
+        // Take the best run to reduce noise from other processes
+        double best = 1e30;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            function();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    const char* getKernelName(fbx::TransformKernel kernel) {
+        switch (kernel) {
+        case fbx::TransformKernel::AVX2: return "AVX2";
+        case fbx::TransformKernel::SSE: return "SSE";
+        default: return "Scalar";
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? (size_t)std::atoll(argv[1]) : 10000000;
+    int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    glm::mat4 matrix = glm::translate(glm::mat4(1.0f), glm::vec3(1.5f, -2.0f, 3.25f));
+    matrix = glm::rotate(matrix, 0.7f, glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+    matrix = glm::scale(matrix, glm::vec3(0.01f, 0.02f, 0.03f));
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(-1000.0f, 1000.0f);
+    std::vector<glm::vec3> points(count);
+    fbx::PointArrays arrays;
+    arrays.x.resize(count);
+    arrays.y.resize(count);
+    arrays.z.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        points[i] = glm::vec3(distribution(random), distribution(random), distribution(random));
+        arrays.x[i] = points[i].x;
+        arrays.y[i] = points[i].y;
+        arrays.z[i] = points[i].z;
+    }
+
+    // The loader used to transform each corner on its own and narrow the result back to a vec3
+    std::vector<glm::vec3> expected(count);
+    double glmTime = timeMilliseconds(repeats, [&]() {
+        for (size_t i = 0; i < count; i++) {
+            expected[i] = matrix * glm::vec4(points[i], 1);
+        }
+    });
+    std::cout << "glm per vertex: " << glmTime << " ms (" << count / (glmTime * 1e3) << " M points/s)" << std::endl;
+
+    fbx::PointArrays transformed;
+    transformed.x.resize(count);
+    transformed.y.resize(count);
+    transformed.z.resize(count);
+    fbx::TransformKernel fastest = fbx::getTransformKernel();
+    for (fbx::TransformKernel kernel : { fbx::TransformKernel::Scalar, fbx::TransformKernel::SSE, fbx::TransformKernel::AVX2 }) {
+        if (kernel > fastest) {
+            break;
+        }
+
+        double time = timeMilliseconds(repeats, [&]() {
+            fbx::transformPoints(matrix, arrays.x.data(), arrays.y.data(), arrays.z.data(),
+                transformed.x.data(), transformed.y.data(), transformed.z.data(), count, kernel);
+        });
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < count; i++) {
+            glm::vec3 point = transformed[i];
+            mismatches += std::memcmp(&point, &expected[i], sizeof(glm::vec3)) != 0;
+        }
+
+        std::cout << getKernelName(kernel) << (kernel == fastest ? " (selected)" : "") << ": " << time << " ms ("
+            << count / (time * 1e3) << " M points/s, " << glmTime / time << "x), " << mismatches << " mismatches" << std::endl;
+    }
+
+    return 0;
+}
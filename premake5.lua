@@ -16,9 +16,39 @@ workspace "FBXFileLoader"
     filter "*"
 
     -- Include files (The default directory)
-    includedirs{"C:/Program Files/Autodesk/FBX/FBX SDK/2020.3.7/include", "ExternalLibraries/glm"}
+    includedirs{"ExternalLibraries/glm"}
+
+    -- zlib is used to decompress the array properties of binary FBX files
+    filter "system:windows"
+        links { "zlib" }
+
+    filter "system:not windows"
+        links { "z", "pthread" }
+
+    filter "*"
 
 project "FileLoader"
     kind "ConsoleApp"
     location "src"
-    files {"src/**.cpp", "src/**.hpp"}
\ No newline at end of file
+    files {"src/**.cpp", "src/**.hpp"}
+
+project "AsciiReaderBenchmark"
+    kind "ConsoleApp"
+    location "bench"
+    includedirs {"src"}
+    files {"bench/AsciiReaderBenchmark.cpp", "src/**.cpp", "src/**.hpp"}
+    removefiles {"src/main.cpp"}
+
+project "MeshCodecBenchmark"
+    kind "ConsoleApp"
+    location "bench"
+    includedirs {"src"}
+    files {"bench/MeshCodecBenchmark.cpp", "src/**.cpp", "src/**.hpp"}
+    removefiles {"src/main.cpp"}
+
+project "TransformBenchmark"
+    kind "ConsoleApp"
+    location "bench"
+    includedirs {"src"}
+    files {"bench/TransformBenchmark.cpp", "src/**.cpp", "src/**.hpp"}
+    removefiles {"src/main.cpp"}
@@ -0,0 +1,359 @@
+#include "FBXDocument.hpp"
+
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FBX_ASCII_SSE2 1
+#endif
+
+namespace fbx {
+
+    namespace {
+        /// <summary>
+        /// Finds the closing brace of an array block and checks whether the
+        /// block holds real numbers, 16 characters at a time when SSE2 is available
+        /// </summary>
+        /// <param name="begin">The first character of the block contents</param>
+        /// <param name="end">The end of the file data</param>
+        /// <param name="hasReal">Set if a '.', 'e' or 'E' is found before the closing brace</param>
+        /// <returns>A pointer to the closing brace or end if there is none</returns>
+        const char* scanArrayBlock(const char* begin, const char* end, bool& hasReal) {
+            const char* current = begin;
+            hasReal = false;
+
+#ifdef FBX_ASCII_SSE2
+            const __m128i closeBrace = _mm_set1_epi8('}');
+            const __m128i point = _mm_set1_epi8('.');
+            const __m128i lowerExponent = _mm_set1_epi8('e');
+            const __m128i upperExponent = _mm_set1_epi8('E');
+
+            while (end - current >= 16) {
+                __m128i block = _mm_loadu_si128((const __m128i*)current);
+                int braceMask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, closeBrace));
+                int realMask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, point),
+                    _mm_or_si128(_mm_cmpeq_epi8(block, lowerExponent), _mm_cmpeq_epi8(block, upperExponent))));
+
+                if (braceMask != 0) {
+                    // Only count the real number characters before the brace
+                    int bracePosition = 0;
+                    while ((braceMask & (1 << bracePosition)) == 0) {
+                        bracePosition++;
+                    }
+                    hasReal |= (realMask & ((1 << bracePosition) - 1)) != 0;
+                    return current + bracePosition;
+                }
+                hasReal |= realMask != 0;
+                current += 16;
+            }
+#endif
+
+            // Scalar scan for the tail (or the whole block without SSE2)
+            for (; current < end; current++) {
+                char c = *current;
+                if (c == '}') {
+                    return current;
+                }
+                hasReal |= (c == '.' || c == 'e' || c == 'E');
+            }
+            return end;
+        }
+
+        /// <summary>
+        /// Tokenizes the text of an ASCII FBX file into node records
+        /// </summary>
+        struct AsciiParser
+        {
+            const char* current;
+            const char* end;
+
+            [[noreturn]] void fail(const char* message) const {
+                throw std::runtime_error(message);
+            }
+
+            /// <summary>
+            /// Skips whitespace (including new lines) and comments
+            /// </summary>
+            void skipWhitespace() {
+                while (current < end) {
+                    char c = *current;
+                    if (c == ';') {
+                        // Comments run to the end of the line
+                        const char* lineEnd = (const char*)std::memchr(current, '\n', end - current);
+                        current = lineEnd ? lineEnd + 1 : end;
+                    }
+                    else if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                        current++;
+                    }
+                    else {
+                        return;
+                    }
+                }
+            }
+
+            /// <summary>
+            /// Skips spaces and tabs only, stopping at the end of the line
+            /// </summary>
+            void skipSpaces() {
+                while (current < end && (*current == ' ' || *current == '\t' || *current == '\r')) {
+                    current++;
+                }
+            }
+
+            std::string_view readIdentifier() {
+                const char* start = current;
+                while (current < end && *current != ':' && *current != ' ' && *current != '\t' && *current != '\n'
+                    && *current != ',' && *current != '{' && *current != '}' && *current != '\r') {
+                    current++;
+                }
+                return std::string_view(start, current - start);
+            }
+
+            /// <summary>
+            /// Decodes the values of an array block straight into the final array storage
+            /// </summary>
+            template<typename T>
+            void readArrayValues(Property& property, const char* blockEnd) {
+                property.decodedArray.resize((size_t)property.arrayCount * sizeof(T));
+                char* output = property.decodedArray.data();
+
+                for (std::uint32_t i = 0; i < property.arrayCount; i++) {
+                    // Skip the separators between the values
+                    while (current < blockEnd && (*current == ',' || *current == ' ' || *current == '\t' || *current == '\r' || *current == '\n')) {
+                        current++;
+                    }
+
+                    T value;
+                    auto result = std::from_chars(current, blockEnd, value);
+                    if (result.ec != std::errc()) {
+                        fail("Invalid number in FBX array.");
+                    }
+                    current = result.ptr;
+                    std::memcpy(output + (size_t)i * sizeof(T), &value, sizeof(T));
+                }
+
+                // Nothing but separators may follow the declared number of values
+                while (current < blockEnd && (*current == ',' || *current == ' ' || *current == '\t' || *current == '\r' || *current == '\n')) {
+                    current++;
+                }
+                if (current < blockEnd) {
+                    fail("More values than the FBX array length.");
+                }
+            }
+
+            /// <summary>
+            /// Reads an array property of the form *count { a: values }
+            /// </summary>
+            Property readArray() {
+                Property property;
+
+                // Skip the '*' and read the element count
+                current++;
+                std::int64_t count = 0;
+                auto result = std::from_chars(current, end, count);
+                if (result.ec != std::errc() || count < 0 || count > UINT32_MAX) {
+                    fail("Invalid FBX array length.");
+                }
+                current = result.ptr;
+                property.arrayCount = (std::uint32_t)count;
+
+                skipWhitespace();
+                if (current >= end || *current != '{') {
+                    fail("Expected '{' after FBX array length.");
+                }
+                current++;
+
+                // The values are stored in a single "a:" record
+                skipWhitespace();
+                if (readIdentifier() != "a" || current >= end || *current != ':') {
+                    fail("Expected 'a:' in FBX array.");
+                }
+                current++;
+
+                // Find the end of the block and the type of the values before decoding them
+                bool hasReal;
+                const char* blockEnd = scanArrayBlock(current, end, hasReal);
+                if (blockEnd == end) {
+                    fail("Unterminated FBX array.");
+                }
+
+                // Each value takes at least one character and a separator, so a longer declared length is corrupt
+                if (property.arrayCount > (size_t)(blockEnd - current + 1) / 2) {
+                    fail("Invalid FBX array length.");
+                }
+
+                if (hasReal) {
+                    property.type = 'd';
+                    readArrayValues<double>(property, blockEnd);
+                }
+                else {
+                    property.type = 'l';
+                    readArrayValues<std::int64_t>(property, blockEnd);
+
+                    // Store the array as 32 bit integers when all the values fit
+                    bool fitsInt = true;
+                    for (std::uint32_t i = 0; i < property.arrayCount && fitsInt; i++) {
+                        std::int64_t value;
+                        std::memcpy(&value, property.decodedArray.data() + (size_t)i * sizeof(value), sizeof(value));
+                        fitsInt = value >= INT32_MIN && value <= INT32_MAX;
+                    }
+                    if (fitsInt) {
+                        for (std::uint32_t i = 0; i < property.arrayCount; i++) {
+                            std::int64_t value;
+                            std::memcpy(&value, property.decodedArray.data() + (size_t)i * sizeof(value), sizeof(value));
+                            std::int32_t narrowValue = (std::int32_t)value;
+                            std::memcpy(property.decodedArray.data() + (size_t)i * sizeof(narrowValue), &narrowValue, sizeof(narrowValue));
+                        }
+                        property.type = 'i';
+                        property.decodedArray.resize((size_t)property.arrayCount * sizeof(std::int32_t));
+                    }
+                }
+
+                current = blockEnd + 1;
+                return property;
+            }
+
+            Property readValue() {
+                Property property;
+                char c = *current;
+
+                if (c == '"') {
+                    // Strings point into the file data without the quotes
+                    const char* start = current + 1;
+                    const char* stringEnd = (const char*)std::memchr(start, '"', end - start);
+                    if (stringEnd == nullptr) {
+                        fail("Unterminated FBX string.");
+                    }
+                    property.type = 'S';
+                    property.stringValue = std::string_view(start, stringEnd - start);
+                    current = stringEnd + 1;
+                }
+                else if (c == '*') {
+                    property = readArray();
+                }
+                else if (c == '-' || c == '+' || c == '.' || (c >= '0' && c <= '9')) {
+                    // Numbers are integers unless they have a decimal point or exponent
+                    const char* start = (c == '+') ? current + 1 : current;
+                    const char* numberEnd = start;
+                    bool isReal = false;
+                    while (numberEnd < end && (std::isdigit((unsigned char)*numberEnd) || *numberEnd == '-' || *numberEnd == '+'
+                        || *numberEnd == '.' || *numberEnd == 'e' || *numberEnd == 'E')) {
+                        isReal |= (*numberEnd == '.' || *numberEnd == 'e' || *numberEnd == 'E');
+                        numberEnd++;
+                    }
+
+                    std::from_chars_result result;
+                    if (isReal) {
+                        property.type = 'D';
+                        result = std::from_chars(start, numberEnd, property.realValue);
+                    }
+                    else {
+                        property.type = 'L';
+                        result = std::from_chars(start, numberEnd, property.integerValue);
+                    }
+                    if (result.ec != std::errc()) {
+                        fail("Invalid FBX number.");
+                    }
+                    current = result.ptr;
+                }
+                else {
+                    // Bare words such as T, Y or W are kept as strings
+                    property.type = 'S';
+                    property.stringValue = readIdentifier();
+                    if (property.stringValue.empty()) {
+                        fail("Unexpected character in FBX file.");
+                    }
+                }
+
+                return property;
+            }
+
+            /// <summary>
+            /// Reads a node record, its properties and nested records
+            /// </summary>
+            void readNode(Node& outNode) {
+                outNode.name = std::string(readIdentifier());
+                if (current >= end || *current != ':') {
+                    fail("Expected ':' after FBX node name.");
+                }
+                current++;
+
+                // Properties are separated by commas and end at the line end or an opening brace
+                while (true) {
+                    skipSpaces();
+                    if (current >= end || *current == '\n' || *current == '}') {
+                        return;
+                    }
+                    if (*current == '{') {
+                        current++;
+                        readNodeList(outNode.children, true);
+                        return;
+                    }
+                    if (*current == ',') {
+                        // Values can continue on the next line after a comma
+                        current++;
+                        skipWhitespace();
+                        continue;
+                    }
+                    outNode.properties.emplace_back(readValue());
+                }
+            }
+
+            /// <summary>
+            /// Reads node records until the closing brace of the parent (or the end of the file)
+            /// </summary>
+            void readNodeList(std::vector<Node>& outNodes, bool nested) {
+                while (true) {
+                    skipWhitespace();
+                    if (current >= end) {
+                        if (nested) {
+                            fail("Unexpected end of FBX file.");
+                        }
+                        return;
+                    }
+                    if (*current == '}') {
+                        if (!nested) {
+                            fail("Unexpected '}' in FBX file.");
+                        }
+                        current++;
+                        return;
+                    }
+
+                    Node node;
+                    readNode(node);
+                    outNodes.emplace_back(std::move(node));
+                }
+            }
+        };
+    }
+
+    Document readAsciiDocument(const char* filename) {
+        // Map the whole file into memory, the string properties point straight into it
+        return readAsciiDocument(MappedFile(filename));
+    }
+
+    Document readAsciiDocument(MappedFile file) {
+        Document document;
+        document.file = std::move(file);
+
+        AsciiParser parser{ document.file.data(), document.file.data() + document.file.size() };
+        parser.readNodeList(document.nodes, false);
+
+        // Get the version from the header
+        if (const Node* header = document.findNode("FBXHeaderExtension")) {
+            const Node* version = header->findChild("FBXVersion");
+            if (version != nullptr && !version->properties.empty()) {
+                document.version = (std::uint32_t)version->properties[0].asInteger();
+            }
+        }
+        if (document.version < 7000 || document.version >= 8000) {
+            throw std::runtime_error("Unsupported FBX file version.");
+        }
+
+        return document;
+    }
+}
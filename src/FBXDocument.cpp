@@ -0,0 +1,621 @@
+#include "FBXDocument.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#include "ThreadPool.hpp"
+
+namespace fbx {
+
+    namespace {
+        // The binary header is the magic string followed by 0x00 0x1a 0x00 and the version
+        const char binaryMagic[] = "Kaydara FBX Binary  ";
+        const size_t binaryHeaderSize = 27;
+
+        // Deflate cannot expand data by more than about 1032 to 1, so larger array lengths are corrupt
+        const std::uint64_t maxDeflateRatio = 1032;
+
+        // The most readFileData allocates up front from a size hint
+        const std::uint64_t maxHintedAllocation = 1ull << 30;
+
+        /// <summary>
+        /// Reads little endian values from a block of memory with bounds checking
+        /// </summary>
+        struct BinaryCursor
+        {
+            const char* data;
+            size_t size;
+            size_t offset;
+
+            void require(size_t count) const {
+                if (count > size || offset > size - count) {
+                    throw std::runtime_error("Unexpected end of FBX file.");
+                }
+            }
+
+            template<typename T>
+            T read() {
+                require(sizeof(T));
+                T value;
+                std::memcpy(&value, data + offset, sizeof(T));
+                offset += sizeof(T);
+                return value;
+            }
+
+            const char* readBytes(size_t count) {
+                require(count);
+                const char* bytes = data + offset;
+                offset += count;
+                return bytes;
+            }
+        };
+
+        size_t getArrayElementSize(char type) {
+            switch (type) {
+            case 'f': case 'i': return 4;
+            case 'd': case 'l': return 8;
+            case 'b': return 1;
+            default:
+                throw std::runtime_error("Unknown FBX array property type.");
+            }
+        }
+
+        /// <summary>
+        /// A compressed array property waiting to be inflated into its final buffer
+        /// </summary>
+        struct InflateJob
+        {
+            const char* source;
+            size_t sourceSize;
+            char* destination;
+            size_t destinationSize;
+        };
+
+        /// <summary>
+        /// State shared by all the records read from a binary file
+        /// </summary>
+        struct BinaryReadContext
+        {
+            std::uint32_t version = 0;
+            bool deferGeometry = false;
+            std::vector<InflateJob> inflateJobs;
+
+            // Names of the records nested directly in a deferred record which are not read
+            std::vector<std::string_view> skippedRecords;
+        };
+
+        enum class RecordResult { End, Read, Skipped };
+
+        /// <summary>
+        /// The fixed part of a node record before its name
+        /// </summary>
+        struct RecordHeader
+        {
+            std::uint64_t endOffset;
+            std::uint64_t numProperties;
+            std::uint64_t propertyListLength;
+            std::uint8_t nameLength;
+        };
+
+        RecordHeader readRecordHeader(BinaryCursor& cursor, std::uint32_t version) {
+            // Version 7.5 onwards uses 64 bit offsets in the record header
+            RecordHeader header;
+            if (version >= 7500) {
+                header.endOffset = cursor.read<std::uint64_t>();
+                header.numProperties = cursor.read<std::uint64_t>();
+                header.propertyListLength = cursor.read<std::uint64_t>();
+            }
+            else {
+                header.endOffset = cursor.read<std::uint32_t>();
+                header.numProperties = cursor.read<std::uint32_t>();
+                header.propertyListLength = cursor.read<std::uint32_t>();
+            }
+            header.nameLength = cursor.read<std::uint8_t>();
+            return header;
+        }
+
+        /// <summary>
+        /// A zlib stream that is reset between arrays instead of being created for each one
+        /// </summary>
+        struct Inflater
+        {
+            z_stream stream{};
+            bool initialised = false;
+
+            ~Inflater() {
+                if (initialised) {
+                    inflateEnd(&stream);
+                }
+            }
+        };
+
+        void inflateArray(const char* source, size_t sourceSize, char* destination, size_t destinationSize) {
+            // Each thread keeps its stream (and the memory zlib allocates for it) between arrays and files
+            thread_local Inflater inflater;
+            z_stream& stream = inflater.stream;
+            if (!inflater.initialised) {
+                if (inflateInit(&stream) != Z_OK) {
+                    throw std::runtime_error("Failed to initialise zlib.");
+                }
+                inflater.initialised = true;
+            }
+            else if (inflateReset(&stream) != Z_OK) {
+                throw std::runtime_error("Failed to reset zlib.");
+            }
+
+            stream.next_in = (Bytef*)source;
+            stream.avail_in = (uInt)sourceSize;
+            stream.next_out = (Bytef*)destination;
+            stream.avail_out = (uInt)destinationSize;
+            int result = inflate(&stream, Z_FINISH);
+
+            if (result != Z_STREAM_END || stream.total_out != destinationSize) {
+                throw std::runtime_error("Failed to decompress FBX array property.");
+            }
+        }
+
+        Property readProperty(BinaryCursor& cursor, std::vector<InflateJob>& inflateJobs) {
+            Property property;
+            property.type = cursor.read<char>();
+
+            switch (property.type) {
+            case 'Y': property.integerValue = cursor.read<std::int16_t>(); break;
+            case 'C': property.integerValue = cursor.read<std::uint8_t>(); break;
+            case 'I': property.integerValue = cursor.read<std::int32_t>(); break;
+            case 'L': property.integerValue = cursor.read<std::int64_t>(); break;
+            case 'F': property.realValue = cursor.read<float>(); break;
+            case 'D': property.realValue = cursor.read<double>(); break;
+            case 'S':
+            case 'R': {
+                std::uint32_t length = cursor.read<std::uint32_t>();
+                const char* bytes = cursor.readBytes(length);
+                property.stringValue = std::string_view(bytes, length);
+                break;
+            }
+            case 'f': case 'd': case 'l': case 'i': case 'b': {
+                std::uint32_t arrayLength = cursor.read<std::uint32_t>();
+                std::uint32_t encoding = cursor.read<std::uint32_t>();
+                std::uint32_t compressedLength = cursor.read<std::uint32_t>();
+
+                size_t decodedSize = (size_t)arrayLength * getArrayElementSize(property.type);
+                const char* bytes = cursor.readBytes(compressedLength);
+
+                property.arrayCount = arrayLength;
+                if (encoding == 0) {
+                    // Uncompressed arrays are used in place
+                    if (compressedLength != decodedSize) {
+                        throw std::runtime_error("Invalid FBX array property length.");
+                    }
+                    property.arrayBytes = bytes;
+                }
+                else if (encoding == 1) {
+                    // Check the length against the compressed size before trusting it for the allocation
+                    if (decodedSize > (std::uint64_t)compressedLength * maxDeflateRatio) {
+                        throw std::runtime_error("Invalid FBX array property length.");
+                    }
+
+                    // Allocate the final buffer now and inflate it once all the records have been read
+                    property.decodedArray.resize(decodedSize);
+                    inflateJobs.push_back({ bytes, compressedLength, property.decodedArray.data(), decodedSize });
+                }
+                else {
+                    throw std::runtime_error("Unknown FBX array property encoding.");
+                }
+                break;
+            }
+            default:
+                throw std::runtime_error("Unknown FBX property type.");
+            }
+
+            return property;
+        }
+
+        /// <summary>
+        /// Decompresses all the queued arrays at once, largest first so the workers finish together
+        /// </summary>
+        void inflateArrays(std::vector<InflateJob>& inflateJobs) {
+            std::sort(inflateJobs.begin(), inflateJobs.end(), [](const InflateJob& a, const InflateJob& b) {
+                return a.destinationSize > b.destinationSize;
+            });
+            ThreadPool::shared().parallelFor(inflateJobs.size(), [&](size_t i) {
+                const InflateJob& job = inflateJobs[i];
+                inflateArray(job.source, job.sourceSize, job.destination, job.destinationSize);
+            });
+        }
+
+        /// <summary>
+        /// Reads a node record and all nested records
+        /// </summary>
+        /// <returns>End if the record was the null record ending a list, Skipped if it was not read</returns>
+        RecordResult readNode(BinaryCursor& cursor, BinaryReadContext& context, Node& outNode, int depth) {
+            size_t recordOffset = cursor.offset;
+
+            RecordHeader header = readRecordHeader(cursor, context.version);
+            std::uint64_t endOffset = header.endOffset;
+            std::uint64_t numProperties = header.numProperties;
+            std::uint64_t propertyListLength = header.propertyListLength;
+            std::uint8_t nameLength = header.nameLength;
+
+            // A record of zeros marks the end of a list of records
+            if (endOffset == 0) {
+                return RecordResult::End;
+            }
+            if (endOffset > cursor.size || endOffset < cursor.offset) {
+                throw std::runtime_error("Invalid FBX node record offset.");
+            }
+
+            outNode.name.assign(cursor.readBytes(nameLength), nameLength);
+
+            // Jump over unwanted records inside geometry objects without reading their properties
+            if (depth == 2) {
+                for (std::string_view skippedRecord : context.skippedRecords) {
+                    if (outNode.name == skippedRecord) {
+                        cursor.offset = endOffset;
+                        return RecordResult::Skipped;
+                    }
+                }
+            }
+
+            size_t propertiesEnd = cursor.offset + propertyListLength;
+            outNode.properties.reserve(numProperties);
+            for (std::uint64_t i = 0; i < numProperties; i++) {
+                outNode.properties.emplace_back(readProperty(cursor, context.inflateJobs));
+            }
+            if (cursor.offset != propertiesEnd) {
+                throw std::runtime_error("Invalid FBX property list length.");
+            }
+
+            // Skip over the contents of geometry objects (Objects is at depth 0) so they can be read on demand
+            if (context.deferGeometry && depth == 1 && outNode.name == "Geometry") {
+                outNode.deferred = true;
+                outNode.recordOffset = recordOffset;
+                outNode.recordSize = endOffset - recordOffset;
+                cursor.offset = endOffset;
+                return RecordResult::Read;
+            }
+
+            // Any remaining space in the record holds the nested records
+            while (cursor.offset < endOffset) {
+                Node child;
+                RecordResult result = readNode(cursor, context, child, depth + 1);
+                if (result == RecordResult::End) {
+                    break;
+                }
+                if (result == RecordResult::Read) {
+                    outNode.children.emplace_back(std::move(child));
+                }
+            }
+            cursor.offset = endOffset;
+
+            return RecordResult::Read;
+        }
+    }
+
+    bool Property::isArray() const {
+        return type == 'f' || type == 'd' || type == 'l' || type == 'i' || type == 'b';
+    }
+
+    std::int64_t Property::asInteger() const {
+        if (type == 'F' || type == 'D') {
+            return (std::int64_t)realValue;
+        }
+        return integerValue;
+    }
+
+    double Property::asReal() const {
+        if (type == 'F' || type == 'D') {
+            return realValue;
+        }
+        return (double)integerValue;
+    }
+
+    const Node* Node::findChild(std::string_view childName) const {
+        for (const Node& child : children) {
+            if (child.name == childName) {
+                return &child;
+            }
+        }
+        return nullptr;
+    }
+
+    const Node* Document::findNode(std::string_view nodeName) const {
+        for (const Node& node : nodes) {
+            if (node.name == nodeName) {
+                return &node;
+            }
+        }
+        return nullptr;
+    }
+
+    Document readBinaryDocument(const char* filename, bool deferGeometry) {
+        // Map the whole file into memory, the properties point straight into it
+        return readBinaryDocument(MappedFile(filename), deferGeometry);
+    }
+
+    Document readBinaryDocument(MappedFile file, bool deferGeometry) {
+        Document document;
+        document.file = std::move(file);
+
+        // Check the header
+        if (document.file.size() < binaryHeaderSize || std::memcmp(document.file.data(), binaryMagic, sizeof(binaryMagic)) != 0) {
+            throw std::runtime_error("File is not a binary FBX file.");
+        }
+
+        BinaryCursor cursor{ document.file.data(), document.file.size(), binaryHeaderSize - sizeof(std::uint32_t) };
+        document.version = cursor.read<std::uint32_t>();
+        if (document.version < 7000 || document.version >= 8000) {
+            throw std::runtime_error("Unsupported FBX file version.");
+        }
+
+        // Read the top level records until the null record
+        BinaryReadContext context;
+        context.version = document.version;
+        context.deferGeometry = deferGeometry;
+        while (cursor.offset < cursor.size) {
+            Node node;
+            if (readNode(cursor, context, node, 0) == RecordResult::End) {
+                break;
+            }
+            document.nodes.emplace_back(std::move(node));
+        }
+
+        inflateArrays(context.inflateJobs);
+
+        return document;
+    }
+
+    Node readDeferredNode(const Document& document, const Node& deferredNode, const std::vector<std::string_view>& skippedRecords) {
+        if (!deferredNode.deferred) {
+            throw std::runtime_error("FBX node was not deferred.");
+        }
+
+        BinaryCursor cursor{ document.file.data(), document.file.size(), (size_t)deferredNode.recordOffset };
+        BinaryReadContext context;
+        context.version = document.version;
+        context.skippedRecords = skippedRecords;
+
+        Node node;
+        if (readNode(cursor, context, node, 1) != RecordResult::Read) {
+            throw std::runtime_error("Invalid deferred FBX node record.");
+        }
+        inflateArrays(context.inflateJobs);
+
+        return node;
+    }
+
+    std::uint32_t getChildArrayLength(const Document& document, const Node& node, std::string_view childName) {
+        if (!node.deferred) {
+            const Node* child = node.findChild(childName);
+            if (child == nullptr || child->properties.empty() || !child->properties[0].isArray()) {
+                return 0;
+            }
+            return child->properties[0].arrayCount;
+        }
+
+        // Jump from record header to record header inside the deferred record
+        BinaryCursor cursor{ document.file.data(), document.file.size(), (size_t)node.recordOffset };
+        RecordHeader header = readRecordHeader(cursor, document.version);
+        std::uint64_t endOffset = header.endOffset;
+        cursor.offset += header.nameLength + header.propertyListLength;
+
+        while (cursor.offset < endOffset) {
+            size_t recordOffset = cursor.offset;
+            RecordHeader childHeader = readRecordHeader(cursor, document.version);
+            if (childHeader.endOffset == 0) {
+                break;
+            }
+            if (childHeader.endOffset > endOffset || childHeader.endOffset <= recordOffset) {
+                throw std::runtime_error("Invalid FBX node record offset.");
+            }
+
+            std::string_view name(cursor.readBytes(childHeader.nameLength), childHeader.nameLength);
+            if (name == childName) {
+                if (childHeader.numProperties == 0) {
+                    return 0;
+                }
+                // Array properties start with the type code and the element count
+                char type = cursor.read<char>();
+                if (type != 'f' && type != 'd' && type != 'l' && type != 'i' && type != 'b') {
+                    return 0;
+                }
+                return cursor.read<std::uint32_t>();
+            }
+            cursor.offset = childHeader.endOffset;
+        }
+        return 0;
+    }
+
+    namespace {
+        /// <summary>
+        /// Passes a property to a visitor in the same form whichever file format it was stored with:
+        /// a class tag, then integers as int64, reals as doubles and strings in the ASCII "Class::Name" form
+        /// </summary>
+        void visitProperty(const Property& property, const std::function<void(const char* bytes, size_t size)>& visit) {
+            if (property.isArray()) {
+                visit("A", 1);
+                visit((const char*)&property.arrayCount, sizeof(property.arrayCount));
+
+                // Widen the elements without going through doubles, which would merge large integers
+                const char* bytes = property.getArrayBytes();
+                switch (property.type) {
+                case 'd': {
+                    visit("D", 1);
+                    visit(bytes, (size_t)property.arrayCount * sizeof(double));
+                    break;
+                }
+                case 'f': {
+                    visit("D", 1);
+                    std::vector<double> values = detail::convertArray<double, float>(bytes, property.arrayCount);
+                    visit((const char*)values.data(), values.size() * sizeof(double));
+                    break;
+                }
+                case 'l': {
+                    visit("I", 1);
+                    visit(bytes, (size_t)property.arrayCount * sizeof(std::int64_t));
+                    break;
+                }
+                default: {
+                    visit("I", 1);
+                    std::vector<std::int64_t> values = property.type == 'i'
+                        ? detail::convertArray<std::int64_t, std::int32_t>(bytes, property.arrayCount)
+                        : detail::convertArray<std::int64_t, std::uint8_t>(bytes, property.arrayCount);
+                    visit((const char*)values.data(), values.size() * sizeof(std::int64_t));
+                    break;
+                }
+                }
+            }
+            else if (property.type == 'S') {
+                visit("S", 1);
+                std::string_view value = property.stringValue;
+                size_t separator = value.find(std::string_view("\x00\x01", 2));
+                if (separator == std::string_view::npos) {
+                    visit(value.data(), value.size());
+                }
+                else {
+                    std::string name = std::string(value.substr(separator + 2)) + "::" + std::string(value.substr(0, separator));
+                    visit(name.data(), name.size());
+                }
+            }
+            else if (property.type == 'R') {
+                visit("R", 1);
+                visit(property.stringValue.data(), property.stringValue.size());
+            }
+            else if (property.type == 'F' || property.type == 'D') {
+                visit("D", 1);
+                visit((const char*)&property.realValue, sizeof(property.realValue));
+            }
+            else {
+                visit("I", 1);
+                visit((const char*)&property.integerValue, sizeof(property.integerValue));
+            }
+        }
+    }
+
+    void visitNodeContents(const Document& document, const Node& node, const std::function<void(const char* bytes, size_t size)>& visit,
+        const std::vector<std::string_view>& skippedRecords) {
+        if (node.deferred) {
+            // Read the nested records so a deferred node gives the same contents as a loaded one
+            visitNodeContents(document, readDeferredNode(document, node, skippedRecords), visit);
+            return;
+        }
+
+        auto isSkipped = [&](const Node& child) {
+            return std::find(skippedRecords.begin(), skippedRecords.end(), child.name) != skippedRecords.end();
+        };
+        std::uint64_t childCount = 0;
+        for (const Node& child : node.children) {
+            childCount += isSkipped(child) ? 0 : 1;
+        }
+
+        visit(node.name.data(), node.name.size());
+        std::uint64_t counts[2] = { node.properties.size(), childCount };
+        visit((const char*)counts, sizeof(counts));
+        for (const Property& property : node.properties) {
+            visitProperty(property, visit);
+        }
+        for (const Node& child : node.children) {
+            if (!isSkipped(child)) {
+                visitNodeContents(document, child, visit);
+            }
+        }
+    }
+
+    Document readDocument(const char* filename, bool deferGeometry) {
+        // Only binary files start with the magic string
+        char header[sizeof(binaryMagic)] = {};
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Failed to open the FBX file.");
+        }
+        file.read(header, sizeof(header));
+
+        if (std::memcmp(header, binaryMagic, sizeof(binaryMagic)) == 0) {
+            return readBinaryDocument(filename, deferGeometry);
+        }
+        return readAsciiDocument(filename);
+    }
+
+    Document readDocument(MappedFile file, bool deferGeometry) {
+        if (file.size() >= sizeof(binaryMagic) && std::memcmp(file.data(), binaryMagic, sizeof(binaryMagic)) == 0) {
+            return readBinaryDocument(std::move(file), deferGeometry);
+        }
+        return readAsciiDocument(std::move(file));
+    }
+
+    MappedFile readFileData(const ReadCallback& read, std::uint64_t sizeHint, size_t chunkSize) {
+        if (chunkSize == 0) {
+            throw std::runtime_error("The read chunk size must not be 0.");
+        }
+
+        // Read each chunk straight into the spare space of the buffer, which is left uninitialized.
+        // With a size hint the buffer is allocated once at that size, up to a limit so a wrong hint
+        // cannot allocate more than that before any data arrives. Larger files grow from there.
+        size_t capacity = sizeHint > 0 ? (size_t)std::min<std::uint64_t>(sizeHint, maxHintedAllocation) : chunkSize;
+        std::unique_ptr<char[]> buffer(new char[capacity]);
+        size_t size = 0;
+        while (true) {
+            if (size < capacity) {
+                size_t requested = std::min(chunkSize, capacity - size);
+                size_t bytesRead = read(buffer.get() + size, requested);
+                if (bytesRead == 0) {
+                    break;
+                }
+                if (bytesRead > requested) {
+                    throw std::runtime_error("FBX read callback returned more data than requested.");
+                }
+                size += bytesRead;
+                continue;
+            }
+
+            // The buffer is full, which is the end of the file when the hint was right.
+            // Probe for more data before growing so an exact hint never costs a copy.
+            char probe[4096];
+            size_t requested = std::min(chunkSize, sizeof(probe));
+            size_t bytesRead = read(probe, requested);
+            if (bytesRead == 0) {
+                break;
+            }
+            if (bytesRead > requested) {
+                throw std::runtime_error("FBX read callback returned more data than requested.");
+            }
+
+            // Grow geometrically, copying only the bytes read so far
+            capacity = std::max(capacity * 2, size + bytesRead);
+            std::unique_ptr<char[]> grown(new char[capacity]);
+            std::memcpy(grown.get(), buffer.get(), size);
+            std::memcpy(grown.get() + size, probe, bytesRead);
+            buffer = std::move(grown);
+            size += bytesRead;
+        }
+
+        return MappedFile(std::move(buffer), size);
+    }
+
+    MappedFile readFileData(std::istream& stream, size_t chunkSize) {
+        // Seekable streams report how much is left, pipes fail and are read without a hint
+        std::uint64_t sizeHint = 0;
+        std::istream::pos_type start = stream.tellg();
+        if (start != std::istream::pos_type(-1) && stream.seekg(0, std::ios::end)) {
+            std::istream::pos_type end = stream.tellg();
+            if (end != std::istream::pos_type(-1) && end >= start) {
+                sizeHint = (std::uint64_t)(end - start);
+            }
+            stream.seekg(start);
+        }
+        stream.clear();
+
+        MappedFile file = readFileData([&](char* buffer, size_t size) {
+            stream.read(buffer, (std::streamsize)size);
+            return (size_t)stream.gcount();
+        }, sizeHint, chunkSize);
+
+        if (stream.bad()) {
+            throw std::runtime_error("Failed to read the FBX stream.");
+        }
+        return file;
+    }
+}
@@ -0,0 +1,297 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <istream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+/// Low level representation of the node records stored in an FBX file.
+namespace fbx {
+	/// <summary>
+	/// A read only view of the elements of an array property.
+	/// The elements are read straight from the file data when the stored type matches T,
+	/// otherwise the view holds a converted copy.
+	/// </summary>
+	template<typename T>
+	class ArrayView
+	{
+	public:
+		ArrayView() = default;
+
+		ArrayView(const char* bytes, size_t count) : elementBytes(bytes), elementCount(count) {}
+
+		explicit ArrayView(std::vector<T> values) : converted(std::move(values)) {
+			elementBytes = (const char*)converted.data();
+			elementCount = converted.size();
+		}
+
+		// The view may point at its own storage so it can only be moved
+		ArrayView(ArrayView&&) = default;
+		ArrayView& operator=(ArrayView&&) = default;
+		ArrayView(const ArrayView&) = delete;
+		ArrayView& operator=(const ArrayView&) = delete;
+
+		size_t size() const { return elementCount; }
+		bool empty() const { return elementCount == 0; }
+
+		T operator[](size_t i) const {
+			// Array data in the file has no alignment so copy the element out
+			T value;
+			std::memcpy(&value, elementBytes + i * sizeof(T), sizeof(T));
+			return value;
+		}
+
+	private:
+		const char* elementBytes = nullptr;
+		size_t elementCount = 0;
+		std::vector<T> converted;
+	};
+
+	/// <summary>
+	/// A single typed value attached to a node record
+	/// </summary>
+	struct Property
+	{
+		// The FBX type code of the property
+		// Scalars: 'Y' int16, 'C' bool, 'I' int32, 'F' float, 'D' double, 'L' int64
+		// Arrays: 'f' float, 'd' double, 'l' int64, 'i' int32, 'b' bool
+		// Other: 'S' string, 'R' raw binary data
+		char type = 0;
+
+		// Scalar values
+		std::int64_t integerValue = 0;
+		double realValue = 0.0;
+
+		// String and raw data values, pointing into the file data
+		std::string_view stringValue;
+
+		// Array values stored as little endian elements
+		std::uint32_t arrayCount = 0;
+		const char* arrayBytes = nullptr;		// Uncompressed arrays point into the file data
+		std::vector<char> decodedArray;			// Storage for arrays which had to be decompressed
+
+		/// <summary>
+		/// Checks if the property holds an array
+		/// </summary>
+		/// <returns>True if the property is an array type</returns>
+		bool isArray() const;
+
+		/// <summary>
+		/// Gets the property as an integer, converting from any scalar type
+		/// </summary>
+		/// <returns>The integer value</returns>
+		std::int64_t asInteger() const;
+
+		/// <summary>
+		/// Gets the property as a double, converting from any scalar type
+		/// </summary>
+		/// <returns>The real value</returns>
+		double asReal() const;
+
+		/// <summary>
+		/// Gets the little endian element data of an array property
+		/// </summary>
+		/// <returns>A pointer to the first element</returns>
+		const char* getArrayBytes() const { return decodedArray.empty() ? arrayBytes : decodedArray.data(); }
+
+		/// <summary>
+		/// Gets a view of the elements of an array property
+		/// </summary>
+		/// <returns>A view of the array, converted if the stored type is not T</returns>
+		template<typename T>
+		ArrayView<T> asArray() const;
+	};
+
+	/// <summary>
+	/// A node record with its properties and nested records
+	/// </summary>
+	struct Node
+	{
+		std::string name;
+		std::vector<Property> properties;
+		std::vector<Node> children;
+
+		// Deferred records only have their properties read, the nested records are
+		// read on demand from the record offset with readDeferredNode
+		bool deferred = false;
+		std::uint64_t recordOffset = 0;
+		std::uint64_t recordSize = 0;
+
+		/// <summary>
+		/// Finds the first nested record with the given name
+		/// </summary>
+		/// <param name="childName">The name of the record to find</param>
+		/// <returns>The record or nullptr if it does not exist</returns>
+		const Node* findChild(std::string_view childName) const;
+	};
+
+	/// <summary>
+	/// The top level records of an FBX file
+	/// </summary>
+	struct Document
+	{
+		std::uint32_t version = 0;
+		std::vector<Node> nodes;
+
+		// The mapped file the properties point into
+		MappedFile file;
+
+		/// <summary>
+		/// Finds the first top level record with the given name
+		/// </summary>
+		/// <param name="nodeName">The name of the record to find</param>
+		/// <returns>The record or nullptr if it does not exist</returns>
+		const Node* findNode(std::string_view nodeName) const;
+	};
+
+	/// <summary>
+	/// Memory maps a binary FBX file (version 7.x) and reads it into a document.
+	/// Strings and uncompressed arrays are not copied, they point into the mapped file.
+	/// Compressed arrays are inflated in parallel on the shared thread pool after all records are read.
+	/// </summary>
+	/// <param name="filename">The .fbx file path</param>
+	/// <param name="deferGeometry">Skip the nested records of the Geometry objects, to be read later with readDeferredNode</param>
+	/// <returns>The parsed document</returns>
+	Document readBinaryDocument(const char* filename, bool deferGeometry = false);
+
+	/// <summary>
+	/// Reads a binary FBX file that is already mapped or held in memory into a document
+	/// </summary>
+	/// <param name="file">The file contents, kept by the document</param>
+	/// <param name="deferGeometry">Skip the nested records of the Geometry objects, to be read later with readDeferredNode</param>
+	/// <returns>The parsed document</returns>
+	Document readBinaryDocument(MappedFile file, bool deferGeometry = false);
+
+	/// <summary>
+	/// Reads the full record (including nested records) of a deferred node
+	/// </summary>
+	/// <param name="document">The document the node belongs to</param>
+	/// <param name="deferredNode">A node that was deferred when the document was read</param>
+	/// <param name="skippedRecords">Names of directly nested records to leave out without reading them</param>
+	/// <returns>The complete node, which points into the document's mapped file</returns>
+	Node readDeferredNode(const Document& document, const Node& deferredNode, const std::vector<std::string_view>& skippedRecords = {});
+
+	/// <summary>
+	/// Gets the element count of the array in a nested record without reading or decompressing the array.
+	/// Deferred nodes are scanned by their record headers only.
+	/// </summary>
+	/// <param name="document">The document the node belongs to</param>
+	/// <param name="node">The node holding the record</param>
+	/// <param name="childName">The name of the directly nested record (e.g. PolygonVertexIndex)</param>
+	/// <returns>The number of elements in the first property, 0 if there is no such array</returns>
+	std::uint32_t getChildArrayLength(const Document& document, const Node& node, std::string_view childName);
+
+	/// <summary>
+	/// Passes the contents of a node and all its nested records to a function: the record names and
+	/// the property values, without the record offsets, so identical records give the same bytes wherever
+	/// they are in the file. The values are passed in one form whatever their stored width (integers as
+	/// int64, reals as doubles, names as "Class::Name"), so a node gives the same bytes from ASCII and
+	/// binary files as long as the ASCII file writes its reals with a decimal point or exponent.
+	/// Deferred nodes are read first, so they give the same bytes as loaded ones.
+	/// </summary>
+	/// <param name="document">The document the node belongs to</param>
+	/// <param name="node">The node to visit</param>
+	/// <param name="visit">Called with each block of bytes in order</param>
+	/// <param name="skippedRecords">Names of directly nested records to leave out, as if they were not in the file</param>
+	void visitNodeContents(const Document& document, const Node& node, const std::function<void(const char* bytes, size_t size)>& visit,
+		const std::vector<std::string_view>& skippedRecords = {});
+
+	/// <summary>
+	/// Memory maps an ASCII FBX file (version 7.x) and reads it into a document.
+	/// Array blocks are decoded straight into their final storage, using the same element types as a binary file.
+	/// </summary>
+	/// <param name="filename">The .fbx file path</param>
+	/// <returns>The parsed document</returns>
+	Document readAsciiDocument(const char* filename);
+
+	/// <summary>
+	/// Reads an ASCII FBX file that is already mapped or held in memory into a document
+	/// </summary>
+	/// <param name="file">The file contents, kept by the document</param>
+	/// <returns>The parsed document</returns>
+	Document readAsciiDocument(MappedFile file);
+
+	/// <summary>
+	/// Reads a binary or ASCII FBX file into a document, depending on the file header
+	/// </summary>
+	/// <param name="filename">The .fbx file path</param>
+	/// <param name="deferGeometry">Defer the Geometry objects of binary files (ASCII files are always read fully)</param>
+	/// <returns>The parsed document</returns>
+	Document readDocument(const char* filename, bool deferGeometry = false);
+
+	/// <summary>
+	/// Reads a binary or ASCII FBX file that is already mapped or held in memory into a document
+	/// </summary>
+	/// <param name="file">The file contents, kept by the document</param>
+	/// <param name="deferGeometry">Defer the Geometry objects of binary files (ASCII files are always read fully)</param>
+	/// <returns>The parsed document</returns>
+	Document readDocument(MappedFile file, bool deferGeometry = false);
+
+	/// <summary>
+	/// Reads up to size bytes into the buffer, returning how many were read. Returning 0 ends the file.
+	/// </summary>
+	using ReadCallback = std::function<size_t(char* buffer, size_t size)>;
+
+	/// <summary>
+	/// Reads a whole file from a source that can only be read in order (a pipe or a decompressor) into memory.
+	/// The data is read in chunks of at most chunkSize bytes straight into the buffer the document will use.
+	/// With an exact size hint of up to 1 GB the buffer is allocated once and never copied, otherwise it grows geometrically. The records point into the file data and the
+	/// geometry is read after the rest of the file, which is why the whole file is kept.
+	/// </summary>
+	/// <param name="read">The source of the file data</param>
+	/// <param name="sizeHint">The expected file size to reserve up front (at most 1 GB of it), 0 if unknown</param>
+	/// <param name="chunkSize">The most bytes requested from the source at once</param>
+	/// <returns>The file contents</returns>
+	MappedFile readFileData(const ReadCallback& read, std::uint64_t sizeHint = 0, size_t chunkSize = 1 << 20);
+
+	/// <summary>
+	/// Reads the rest of a stream into memory in chunks, see the callback version.
+	/// The size is reserved up front when the stream can report it.
+	/// </summary>
+	/// <param name="stream">The stream holding the file, opened in binary mode</param>
+	/// <param name="chunkSize">The most bytes read from the stream at once</param>
+	/// <returns>The file contents</returns>
+	MappedFile readFileData(std::istream& stream, size_t chunkSize = 1 << 20);
+
+	namespace detail {
+		template<typename T> constexpr char arrayTypeCode() { return 0; }
+		template<> constexpr char arrayTypeCode<float>() { return 'f'; }
+		template<> constexpr char arrayTypeCode<double>() { return 'd'; }
+		template<> constexpr char arrayTypeCode<std::int64_t>() { return 'l'; }
+		template<> constexpr char arrayTypeCode<std::int32_t>() { return 'i'; }
+
+		template<typename Out, typename In>
+		std::vector<Out> convertArray(const char* bytes, size_t count) {
+			std::vector<Out> output(count);
+			for (size_t i = 0; i < count; i++) {
+				In value;
+				std::memcpy(&value, bytes + i * sizeof(In), sizeof(In));
+				output[i] = (Out)value;
+			}
+			return output;
+		}
+	}
+
+	template<typename T>
+	ArrayView<T> Property::asArray() const {
+		// Point straight at the data when no conversion is needed
+		if (type == detail::arrayTypeCode<T>()) {
+			return ArrayView<T>(getArrayBytes(), arrayCount);
+		}
+
+		switch (type) {
+		case 'f': return ArrayView<T>(detail::convertArray<T, float>(getArrayBytes(), arrayCount));
+		case 'd': return ArrayView<T>(detail::convertArray<T, double>(getArrayBytes(), arrayCount));
+		case 'l': return ArrayView<T>(detail::convertArray<T, std::int64_t>(getArrayBytes(), arrayCount));
+		case 'i': return ArrayView<T>(detail::convertArray<T, std::int32_t>(getArrayBytes(), arrayCount));
+		case 'b': return ArrayView<T>(detail::convertArray<T, std::uint8_t>(getArrayBytes(), arrayCount));
+		default:
+			throw std::runtime_error("FBX property is not an array.");
+		}
+	}
+}
@@ -2,140 +2,598 @@
 
 #include "gtx/quaternion.hpp"
 #include "gtx/string_cast.hpp"
-#include "gtx/hash.hpp"
 
+#include "FBXSceneCache.hpp"
+#include "FBXTransform.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <mutex>
 #include <unordered_map> 
-
-// Link the libraries necessary for the execution mode
-// The file paths are based on the default location for the 2020.3.7 version of the SDK
-#if _DEBUG
-#pragma comment (lib, "C:\\Program Files\\Autodesk\\FBX\\FBX SDK\\2020.3.7\\lib\\x64\\debug\\libfbxsdk-md.lib")
-#pragma comment (lib, "C:\\Program Files\\Autodesk\\FBX\\FBX SDK\\2020.3.7\\lib\\x64\\debug\\libxml2-md.lib")
-#pragma comment (lib, "C:\\Program Files\\Autodesk\\FBX\\FBX SDK\\2020.3.7\\lib\\x64\\debug\\zlib-md.lib")
-#else
-#pragma comment (lib, "C:\\Program Files\\Autodesk\\FBX\\FBX SDK\\2020.3.7\\lib\\x64\\release\\libfbxsdk-md.lib")
-#pragma comment (lib, "C:\\Program Files\\Autodesk\\FBX\\FBX SDK\\2020.3.7\\lib\\x64\\release\\libxml2-md.lib")
-#pragma comment (lib, "C:\\Program Files\\Autodesk\\FBX\\FBX SDK\\2020.3.7\\lib\\x64\\release\\zlib-md.lib")
-#endif
+#include <unordered_set>
 
 #define DEBUG_OUTPUTS false
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FBX_LOADER_SSE2 1
+#endif
+
 namespace fbx {
 
-    Scene loadFBXFile(const char* filename) {
+    /// <summary>
+    /// The temporary buffers used to build a mesh. They are cleared for every mesh but keep their memory.
+    /// </summary>
+    struct MeshBuffers
+    {
+        Triangulation triangulation;
+
+        // The control points and normals of the mesh after the transform
+        PointArrays positions;
+        PointArrays normals;
+
+        // Used to merge identical corners into vertices
+        VertexWelder welder;
+        std::vector<std::uint32_t> vertexSources;
+    };
+
+    /// <summary>
+    /// Hands out mesh buffers to the threads building meshes, each thread returns its buffers when done
+    /// </summary>
+    class MeshBufferPool
+    {
+    public:
+        std::unique_ptr<MeshBuffers> acquire() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (freeBuffers.empty()) {
+                return std::make_unique<MeshBuffers>();
+            }
+            std::unique_ptr<MeshBuffers> buffers = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
+            return buffers;
+        }
+
+        void release(std::unique_ptr<MeshBuffers> buffers) {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBuffers.emplace_back(std::move(buffers));
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            freeBuffers.clear();
+        }
+
+    private:
+        std::mutex mutex;
+        std::vector<std::unique_ptr<MeshBuffers>> freeBuffers;
+    };
+
+    namespace {
+        void countNode(const SceneNode& node, const SceneGraph& graph, const LoadOptions& options, std::unordered_set<std::string>& materialNames, SceneStats& stats) {
+            stats.nodeCount++;
+
+            // Materials are shared by name, the same way getNodeMaterials finds them
+            if (options.loadMaterials) {
+                for (const Node* material : node.materials) {
+                    materialNames.insert(getObjectName(*material));
+                }
+            }
+
+            if (node.geometry == nullptr) {
+                stats.lightCount += (node.light != nullptr && options.loadLights) ? 1 : 0;
+            }
+            else if (!options.skipMesh || !options.skipMesh(node.name)) {
+                stats.meshCount++;
+                stats.controlPointCount += getChildArrayLength(graph.document, *node.geometry, "Vertices") / 3;
+                stats.polygonVertexCount += getChildArrayLength(graph.document, *node.geometry, "PolygonVertexIndex");
+            }
+
+            for (size_t child : node.children) {
+                countNode(graph.nodes[child], graph, options, materialNames, stats);
+            }
+        }
+
+        /// <summary>
+        /// Reserves the scene vectors filled while walking the nodes
+        /// </summary>
+        void reserveScene(const SceneStats& stats, Scene& outputScene, std::vector<const SceneNode*>& meshNodes) {
+            outputScene.meshes.reserve(stats.meshCount);
+            outputScene.materials.reserve(stats.materialCount);
+            outputScene.lights.reserve(stats.lightCount);
+
+            // Phong materials add at most one entry to each texture set
+            outputScene.diffuseTextures.reserve(stats.materialCount);
+            outputScene.specularTextures.reserve(stats.materialCount);
+            outputScene.normalTextures.reserve(stats.materialCount);
+            outputScene.emissiveTextures.reserve(stats.materialCount);
+
+            meshNodes.reserve(stats.meshCount);
+        }
+
+        /// <summary>
+        /// Gets the records inside a geometry object the loader never uses, along with the ones the options skip
+        /// </summary>
+        std::vector<std::string_view> getSkippedGeometryRecords(const LoadOptions& options) {
+            std::vector<std::string_view> skippedRecords = {
+                "LayerElementTangent", "LayerElementBinormal", "LayerElementColor", "LayerElementSmoothing",
+                "LayerElementVisibility", "LayerElementEdgeCrease", "Edges" };
+            if (!options.loadNormals) {
+                skippedRecords.emplace_back("LayerElementNormal");
+            }
+            if (!options.loadTextureCoords) {
+                skippedRecords.emplace_back("LayerElementUV");
+            }
+            if (!options.loadMaterials) {
+                skippedRecords.emplace_back("LayerElementMaterial");
+            }
+            return skippedRecords;
+        }
+
+        /// <summary>
+        /// Hashes everything a mesh is built from: the geometry records the loader reads, the node
+        /// transform, the materials and the load options
+        /// </summary>
+        std::uint64_t hashMeshSource(const Document& document, const Node& geometry, const SceneNode& node,
+            const std::vector<uint32_t>& materialIndices, const LoadOptions& options) {
+            std::uint64_t fingerprint = hashLoadOptions(options);
+            fingerprint = hashBytes((const char*)&meshFingerprintVersion, sizeof(meshFingerprintVersion), fingerprint);
+            visitNodeContents(document, geometry, [&](const char* bytes, size_t size) {
+                fingerprint = hashBytes(bytes, size, fingerprint);
+            }, getSkippedGeometryRecords(options));
+            glm::mat4 transform = getMeshTransform(node, options);
+            fingerprint = hashBytes((const char*)&transform, sizeof(transform), fingerprint);
+            fingerprint = hashBytes((const char*)materialIndices.data(), materialIndices.size() * sizeof(uint32_t), fingerprint);
+            return fingerprint;
+        }
+
+        /// <summary>
+        /// Stops a load that has been cancelled
+        /// </summary>
+        void checkCancelled(const LoadProgress* progress) {
+            if (progress != nullptr && progress->cancelled.load()) {
+                throw std::runtime_error("FBX load was cancelled.");
+            }
+        }
+
+        /// <summary>
+        /// Builds the meshes of the gathered slots in parallel and hands each one over as soon as it is finished.
+        /// The callback is never run by two threads at once. Meshes not started when the load is cancelled are left empty.
+        /// </summary>
+        void buildMeshes(const SceneGraph& graph, const std::vector<const SceneNode*>& meshNodes, std::vector<Mesh>& meshSlots, const LoadOptions& options,
+            MeshBufferPool& buffers, LoadProgress* progress, const std::function<void(size_t meshIndex, Mesh& mesh)>& onMesh) {
+            std::mutex callbackMutex;
+            ThreadPool::shared().parallelFor(meshNodes.size(), [&](size_t i) {
+                if (progress != nullptr && progress->cancelled.load()) {
+                    return;
+                }
+
+                std::vector<uint32_t> materialIndices = std::move(meshSlots[i].materials);
+                std::unique_ptr<MeshBuffers> meshBuffers = buffers.acquire();
+                Mesh mesh = readMeshData(graph, *meshNodes[i]->geometry, materialIndices, getMeshTransform(*meshNodes[i], options), options, *meshBuffers);
+                buffers.release(std::move(meshBuffers));
+                mesh.materials = std::move(materialIndices);
+
+                if (progress != nullptr) {
+                    progress->bytesParsed += meshNodes[i]->geometry->recordSize;
+                    progress->meshesBuilt++;
+                }
+
+                std::lock_guard<std::mutex> lock(callbackMutex);
+                onMesh(i, mesh);
+            });
+        }
+
+        Scene loadScene(MappedFile file, const char* filename, const LoadOptions& options, MeshBufferPool& buffers, LoadProgress* progress) {
 
-        // Create the FBX Memory Manager
-        FbxManager* memoryManager = FbxManager::Create();
+            std::cout << "Loading " << filename << std::endl;
 
-        // Create the IO settings for the import settings
-        FbxIOSettings* ioSettings = FbxIOSettings::Create(memoryManager, IOSROOT);
+            // Look for the processed scene in the cache directory, unless the options cannot be compared
+            bool useCache = !options.cacheDirectory.empty() && !options.skipMesh;
+            std::uint64_t cacheKey = 0;
+            if (useCache) {
+                cacheKey = getSceneCacheKey(file.data(), file.size(), options);
 
-        // Assign the IO settings to the memory manager
-        memoryManager->SetIOSettings(ioSettings);
+                Scene cachedScene;
+                if (readCachedScene(options.cacheDirectory, cacheKey, cachedScene)) {
+                    if (progress != nullptr) {
+                        progress->totalBytes = file.size();
+                        progress->bytesParsed = progress->totalBytes.load();
+                        progress->meshCount = cachedScene.meshes.size();
+                        progress->meshesBuilt = cachedScene.meshes.size();
+                    }
+                    std::cout << "Finished loading " << filename << " from the cache" << std::endl;
+                    return cachedScene;
+                }
+            }
 
-        // Adjust the import settings in the memory manager so that only the required data is imported
-        (*(memoryManager->GetIOSettings())).SetBoolProp(IMP_FBX_LINK, false);
-        (*(memoryManager->GetIOSettings())).SetBoolProp(IMP_FBX_SHAPE, false);
-        (*(memoryManager->GetIOSettings())).SetBoolProp(IMP_FBX_GOBO, false);
-        (*(memoryManager->GetIOSettings())).SetBoolProp(IMP_FBX_ANIMATION, false);
+            // Read the node records of the file and link the objects together into a scene graph
+            // The geometry records are only read once a mesh passes the load options
+            SceneGraph graph = buildSceneGraph(readDocument(std::move(file), true));
+            checkCancelled(progress);
+
+            // Count everything except the deferred geometry records as parsed
+            if (progress != nullptr) {
+                std::uint64_t deferredBytes = 0;
+                if (const Node* objects = graph.document.findNode("Objects")) {
+                    for (const Node& object : objects->children) {
+                        deferredBytes += object.deferred ? object.recordSize : 0;
+                    }
+                }
+                progress->totalBytes = graph.document.file.size();
+                progress->bytesParsed = graph.document.file.size() - deferredBytes;
+            }
 
-        // Create and initialise the importer using the above settings
-        FbxImporter* importer = FbxImporter::Create(memoryManager, "");
+            // Get the root node of the scene
+            const SceneNode& rootNode = graph.nodes[0];
+
+            // Gather the materials, lights and mesh nodes in scene order
+            Scene outputScene;
+            std::vector<const SceneNode*> meshNodes;
+            reserveScene(getSceneStats(graph, options), outputScene, meshNodes);
+            getChildren(rootNode, graph, outputScene, meshNodes, options);
+            if (progress != nullptr) {
+                progress->nodesVisited = graph.nodes.size();
+                progress->meshCount = meshNodes.size();
+            }
+
+            // Build the meshes in parallel, each one reads, triangulates and converts its own geometry
+            buildMeshes(graph, meshNodes, outputScene.meshes, options, buffers, progress, [&](size_t meshIndex, Mesh& mesh) {
+                outputScene.meshes[meshIndex] = std::move(mesh);
+            });
+            checkCancelled(progress);
 
-        // Use the first argument as the filename for the importer.
-        if (!importer->Initialize(filename, -1, memoryManager->GetIOSettings())) {
-            throw std::runtime_error("Failed to initialise the importer.");
+            // The geometry of skipped meshes was never read but the file is done
+            if (progress != nullptr) {
+                progress->bytesParsed = progress->totalBytes.load();
+            }
+
+            if (DEBUG_OUTPUTS) {
+                std::cout << std::endl;
+                std::cout << "Number of meshes: " << outputScene.meshes.size() << std::endl;
+                std::cout << "Number of materials: " << outputScene.materials.size() << std::endl;
+                std::cout << std::endl;
+            }
+
+            // A failed cache write only costs the next load its cache hit
+            if (useCache) {
+                try {
+                    writeCachedScene(options.cacheDirectory, cacheKey, outputScene);
+                }
+                catch (const std::exception& error) {
+                    std::cout << "Failed to write the scene cache: " << error.what() << std::endl;
+                }
+            }
+
+            std::cout << "Finished loading " << filename << std::endl;
+
+            return outputScene;
         }
+    }
+
+    SceneStats getSceneStats(const SceneGraph& graph, const LoadOptions& options) {
+        SceneStats stats;
+        std::unordered_set<std::string> materialNames;
+        countNode(graph.nodes[0], graph, options, materialNames, stats);
+        stats.materialCount = materialNames.size();
+        return stats;
+    }
+
+    SceneStats getSceneStats(const char* filename, const LoadOptions& options) {
+        SceneGraph graph = buildSceneGraph(readDocument(filename, true));
+        return getSceneStats(graph, options);
+    }
+
+    Scene loadFBXFile(const char* filename, const LoadOptions& options) {
+        MeshBufferPool buffers;
+        return loadScene(MappedFile(filename), filename, options, buffers, nullptr);
+    }
+
+    Scene loadFBXFile(std::span<const std::byte> data, const LoadOptions& options) {
+        MeshBufferPool buffers;
+        return loadScene(MappedFile((const char*)data.data(), data.size()), "<memory>", options, buffers, nullptr);
+    }
+
+    Scene loadFBXFile(std::istream& stream, const LoadOptions& options) {
+        MeshBufferPool buffers;
+        return loadScene(readFileData(stream), "<stream>", options, buffers, nullptr);
+    }
+
+    Scene loadFBXFile(const ReadCallback& read, const LoadOptions& options) {
+        MeshBufferPool buffers;
+        return loadScene(readFileData(read), "<stream>", options, buffers, nullptr);
+    }
+
+    Loader::Loader(const LoadOptions& options)
+        : options(options), buffers(std::make_unique<MeshBufferPool>()) {
+    }
+
+    Loader::~Loader() = default;
+
+    Scene Loader::load(const char* filename) {
+        return loadScene(MappedFile(filename), filename, options, *buffers, nullptr);
+    }
+
+    Scene Loader::load(std::span<const std::byte> data) {
+        return loadScene(MappedFile((const char*)data.data(), data.size()), "<memory>", options, *buffers, nullptr);
+    }
+
+    Scene Loader::load(std::istream& stream) {
+        return loadScene(readFileData(stream), "<stream>", options, *buffers, nullptr);
+    }
+
+    Scene Loader::load(const ReadCallback& read) {
+        return loadScene(readFileData(read), "<stream>", options, *buffers, nullptr);
+    }
 
-        std::cout << "Loading " << filename << std::endl;
+    void Loader::releaseBuffers() {
+        buffers->clear();
+    }
+
+    std::vector<Scene> loadFBXFiles(const std::vector<std::string>& filenames, unsigned threadCount, const LoadOptions& options) {
+        std::vector<Scene> scenes(filenames.size());
+
+        // The calling thread loads files as well
+        ThreadPool& pool = ThreadPool::shared();
+        size_t maxThreads = (size_t)pool.size() + 1;
+        size_t numThreads = std::min(threadCount == 0 ? maxThreads : std::min((size_t)threadCount, maxThreads), filenames.size());
+
+        // Each thread takes the next file until none are left, or until a load has failed
+        std::atomic<size_t> nextFile{ 0 };
+        std::atomic<bool> failed{ false };
+        pool.parallelFor(numThreads, [&](size_t) {
+            Loader loader(options);
+            size_t i;
+            while (!failed.load() && (i = nextFile.fetch_add(1)) < filenames.size()) {
+                try {
+                    scenes[i] = loader.load(filenames[i].c_str());
+                }
+                catch (...) {
+                    failed = true;
+                    throw;
+                }
+            }
+        });
 
-        // Create a scene object to store the data from the .fbx file
-        FbxScene* scene = FbxScene::Create(memoryManager, "Scene");
+        return scenes;
+    }
 
-        // Import the .fbx file and store within the scene object created and destroy the importer.
-        importer->Import(scene);
-        importer->Destroy();
+    Scene reloadFBXFile(const char* filename, Scene& previousScene, std::vector<std::uint64_t>& meshFingerprints, const LoadOptions& options) {
 
-        // Triangulate the scene
-        FbxGeometryConverter converter(memoryManager);
-        converter.Triangulate(scene, true);
+        std::cout << "Reloading " << filename << std::endl;
 
-        // Get the root node of the scene
-        FbxNode* rootNode = scene->GetRootNode();
+        SceneGraph graph = buildSceneGraph(readDocument(filename, true));
 
         Scene outputScene;
-        std::unordered_map<std::string, std::uint32_t> materialMap;
-        getChildren(rootNode, outputScene);
-        
-        if (DEBUG_OUTPUTS) {
-            std::cout << std::endl;
-            std::cout << "Number of meshes: " << outputScene.meshes.size() << std::endl;
-            std::cout << "Number of materials: " << outputScene.materials.size() << std::endl;
-            std::cout << std::endl;
-        }        
+        std::vector<const SceneNode*> meshNodes;
+        reserveScene(getSceneStats(graph, options), outputScene, meshNodes);
+        getChildren(graph.nodes[0], graph, outputScene, meshNodes, options);
+
+        // Previous meshes by fingerprint, the fingerprints only count if they belong to the previous scene
+        std::unordered_map<std::uint64_t, std::vector<size_t>> previousMeshes;
+        if (meshFingerprints.size() == previousScene.meshes.size()) {
+            for (size_t i = 0; i < meshFingerprints.size(); i++) {
+                previousMeshes[meshFingerprints[i]].emplace_back(i);
+            }
+        }
 
-        // Destroy the SDK manager and all the other objects it was handling.
-        memoryManager->Destroy();
+        // Read each geometry record once, to fingerprint it and to build it if no previous mesh matches.
+        // Like a cold load, a geometry record only lives while its mesh is handled.
+        std::vector<std::string_view> skippedRecords = getSkippedGeometryRecords(options);
+        std::vector<std::uint64_t> fingerprints(meshNodes.size());
+        std::atomic<size_t> rebuiltCount{ 0 };
+        std::mutex previousMutex;
+        MeshBufferPool buffers;
+        ThreadPool::shared().parallelFor(meshNodes.size(), [&](size_t i) {
+            const SceneNode& node = *meshNodes[i];
+            Node deferredGeometry;
+            const Node* geometry = node.geometry;
+            if (geometry->deferred) {
+                deferredGeometry = readDeferredNode(graph.document, *geometry, skippedRecords);
+                geometry = &deferredGeometry;
+            }
 
-        std::cout << "Finished loading " << filename << std::endl;
+            std::vector<uint32_t> materialIndices = std::move(outputScene.meshes[i].materials);
+            fingerprints[i] = hashMeshSource(graph.document, *geometry, node, materialIndices, options);
+
+            // Meshes with equal fingerprints are equal, so any of the matching previous meshes can be taken
+            size_t previousIndex = previousScene.meshes.size();
+            {
+                std::lock_guard<std::mutex> lock(previousMutex);
+                auto previous = previousMeshes.find(fingerprints[i]);
+                if (previous != previousMeshes.end() && !previous->second.empty()) {
+                    previousIndex = previous->second.back();
+                    previous->second.pop_back();
+                }
+            }
+            if (previousIndex < previousScene.meshes.size()) {
+                outputScene.meshes[i] = std::move(previousScene.meshes[previousIndex]);
+                return;
+            }
+
+            std::unique_ptr<MeshBuffers> meshBuffers = buffers.acquire();
+            Mesh mesh = createMeshData(*geometry, materialIndices, getMeshTransform(node, options), options, *meshBuffers);
+            buffers.release(std::move(meshBuffers));
+            mesh.materials = std::move(materialIndices);
+            outputScene.meshes[i] = std::move(mesh);
+            rebuiltCount++;
+        });
+
+        meshFingerprints = std::move(fingerprints);
+
+        std::cout << "Finished reloading " << filename << ", rebuilt " << rebuiltCount.load() << " of " << meshNodes.size() << " meshes" << std::endl;
 
         return outputScene;
     }
 
-    void getChildren(FbxNode* node, Scene& outputScene) {
-        // Get the number of children in the node
-        int numChildren = node->GetChildCount();
+    std::uint64_t getMeshFingerprint(const SceneGraph& graph, const SceneNode& node, const std::vector<uint32_t>& materialIndices, const LoadOptions& options) {
+        return hashMeshSource(graph.document, *node.geometry, node, materialIndices, options);
+    }
+
+    AsyncLoad loadFBXFileAsync(const char* filename, const LoadOptions& options) {
+        AsyncLoad load;
+        load.progress = std::make_shared<LoadProgress>();
+
+        // The task owns copies of everything it uses so the caller can return straight away
+        auto promise = std::make_shared<std::promise<Scene>>();
+        load.scene = promise->get_future();
+        ThreadPool::shared().submit([promise, path = std::string(filename), options, progress = load.progress]() {
+            try {
+                MeshBufferPool buffers;
+                promise->set_value(loadScene(MappedFile(path.c_str()), path.c_str(), options, buffers, progress.get()));
+            }
+            catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+
+        return load;
+    }
+
+    void streamFBXFile(const char* filename, const LoadCallbacks& callbacks, const LoadOptions& options) {
+
+        std::cout << "Streaming " << filename << std::endl;
+
+        SceneGraph graph = buildSceneGraph(readDocument(filename, true));
+
+        // Walking the nodes does not touch the geometry so the materials and lights are ready almost straight away
+        Scene outputScene;
+        std::vector<const SceneNode*> meshNodes;
+        reserveScene(getSceneStats(graph, options), outputScene, meshNodes);
+        getChildren(graph.nodes[0], graph, outputScene, meshNodes, options);
+
+        if (callbacks.onMaterial) {
+            for (size_t i = 0; i < outputScene.materials.size(); i++) {
+                callbacks.onMaterial((std::uint32_t)i, outputScene.materials[i], outputScene);
+            }
+        }
+        if (callbacks.onLight) {
+            for (const Light& light : outputScene.lights) {
+                callbacks.onLight(light);
+            }
+        }
+        if (callbacks.onInstance) {
+            for (const MeshInstance& instance : outputScene.instances) {
+                callbacks.onInstance(instance);
+            }
+        }
+
+        // Each mesh is handed over as soon as it is built and is not kept afterwards
+        MeshBufferPool buffers;
+        buildMeshes(graph, meshNodes, outputScene.meshes, options, buffers, nullptr, [&](size_t meshIndex, Mesh& mesh) {
+            if (callbacks.onMesh) {
+                callbacks.onMesh(meshIndex, mesh);
+            }
+        });
+
+        std::cout << "Finished streaming " << filename << std::endl;
+    }
+
+    namespace {
+        void visitChildren(const SceneNode& node, const SceneGraph& graph, Scene& outputScene, std::vector<const SceneNode*>& meshNodes, const LoadOptions& options,
+            GeometryInstances& instances) {
+            // Get the number of children in the node
+            size_t numChildren = node.children.size();
+
+            if(DEBUG_OUTPUTS)
+                std::cout << "Name: " << node.name << " Number of children: " << numChildren << " Number of materials: " << node.materials.size() << std::endl;
+
+            // Get the global transform matrix of the node
+            glm::mat4 transformMatrix = node.globalTransform;
+
+            // Check for materials
+            std::vector<uint32_t> materialIndices = getNodeMaterials(node, graph, outputScene, options);
+
+            // Check if the node has a mesh component
+            const Node* nodeMesh = node.geometry;
+            if (nodeMesh == nullptr) {
+                if (DEBUG_OUTPUTS) {
+                    std::cout << "Node has no mesh component." << std::endl;
+                }
+                const Node* light = node.light;
+                if (light != nullptr && options.loadLights) {
+                    outputScene.lights.emplace_back(createLightData(*light, graph, transformMatrix));
+                }
+            }
+            else if (!options.skipMesh || !options.skipMesh(node.name)) {
+                // Instanced geometry is built once for each set of materials
+                size_t meshIndex = instances.findMeshSlot(node, materialIndices, meshNodes.size(), outputScene, options);
+
+                // Leave a slot for the mesh data, it is created once all the nodes have been visited
+                if (meshIndex == meshNodes.size()) {
+                    outputScene.meshes.emplace_back();
+                    outputScene.meshes.back().materials = materialIndices;
+                    meshNodes.emplace_back(&node);
+                }
+            }
 
-        if(DEBUG_OUTPUTS)
-            std::cout << "Name: " << node->GetName() << " Number of children: " << numChildren << " Number of materials: " << node->GetMaterialCount() << std::endl;
+            // If there is no children do not recurse
+            if (numChildren == 0) {
+                return;
+            }
 
-        // Get the global transform matrix of the node
-        FbxAMatrix nodeTransform = node->EvaluateGlobalTransform();
+            // Visit all the children of the current node
+            for (size_t i = 0; i < numChildren; i++) {
+                const SceneNode& childNode = graph.nodes[node.children[i]];
+                visitChildren(childNode, graph, outputScene, meshNodes, options, instances);
+            }
+        }
+    }
 
-        // Set the scale of the transform
-        //FbxVector4 fbxScale = nodeTransform.GetS() * 0.01;
-        FbxVector4 fbxScale = nodeTransform.GetS();
-        nodeTransform.SetS(fbxScale);
+    size_t GeometryInstances::KeyHash::operator()(const Key& key) const {
+        std::uint64_t hash = std::hash<const Node*>()(key.geometry);
+        for (uint32_t material : key.materials) {
+            hash = (hash ^ material) * 0x9e3779b97f4a7c15ull;
+        }
+        return (size_t)(hash ^ (hash >> 32));
+    }
 
-        // Convert it to GLM
-        glm::mat4 transformMatrix;
-        FbxVector4 col0 = nodeTransform.GetRow(0);
-        transformMatrix[0] = glm::vec4(col0[0], col0[1], col0[2], col0[3]);
-        FbxVector4 col1 = nodeTransform.GetRow(1);
-        transformMatrix[1] = glm::vec4(col1[0], col1[1], col1[2], col1[3]);
-        FbxVector4 col2 = nodeTransform.GetRow(2);
-        transformMatrix[2] = glm::vec4(col2[0], col2[1], col2[2], col2[3]);
-        FbxVector4 col3 = nodeTransform.GetRow(3);
-        transformMatrix[3] = glm::vec4(col3[0], col3[1], col3[2], col3[3]);
+    size_t GeometryInstances::findMeshSlot(const SceneNode& node, const std::vector<uint32_t>& materialIndices, size_t slotCount, Scene& outputScene, const LoadOptions& options) {
+        if (!options.instanceGeometry) {
+            return slotCount;
+        }
+
+        // The vertex material IDs index the scene materials, so nodes only share a mesh when their materials match too
+        size_t slot = slots.try_emplace(Key{ node.geometry, materialIndices }, slotCount).first->second;
+        outputScene.instances.emplace_back(MeshInstance{ (uint32_t)slot, node.globalTransform });
+        return slot;
+    }
+
+    void getChildren(const SceneNode& node, const SceneGraph& graph, Scene& outputScene, std::vector<const SceneNode*>& meshNodes, const LoadOptions& options) {
+        GeometryInstances instances;
+        visitChildren(node, graph, outputScene, meshNodes, options, instances);
+    }
 
-        // Reset the translation component so it is unaffected by scale
-        //FbxVector4 fbxTranslation = nodeTransform.GetT() * 0.01;
-        FbxVector4 fbxTranslation = nodeTransform.GetT();
-        glm::vec4 translation = glm::vec4(fbxTranslation[0], fbxTranslation[1], fbxTranslation[2], 1);
-        transformMatrix[3] = translation;
+    glm::mat4 getMeshTransform(const SceneNode& node, const LoadOptions& options) {
+        return options.instanceGeometry ? glm::mat4(1.0f) : node.globalTransform;
+    }
 
-        // Check for materials
+    std::vector<uint32_t> getNodeMaterials(const SceneNode& node, const SceneGraph& graph, Scene& outputScene, const LoadOptions& options) {
         std::vector<uint32_t> materialIndices;
-        if (node->GetMaterialCount() > 0) {
-            for (int i = 0; i < node->GetMaterialCount(); i++) {
+        if (node.materials.size() > 0 && options.loadMaterials) {
+            for (size_t i = 0; i < node.materials.size(); i++) {
                 // Reset material index
-                uint32_t materialIndex = -1;
+                uint32_t materialIndex = 0xffffffff;
                 
                 // Only get the first material for now and apply it to the entire mesh.
-                FbxSurfaceMaterial* material = node->GetMaterial(i);
+                const Node& material = *node.materials[i];
+                std::string materialName = getObjectName(material);
 
                 // Check if the material data has already been made
                 for (size_t i = 0; i < outputScene.materials.size(); i++) {
-                    if (outputScene.materials[i].materialName == material->GetName()) {
+                    if (outputScene.materials[i].materialName == materialName) {
                         materialIndex = i;
                         break;
                     }
                 }
 
                 // If material has not been found create one for it
-                if (materialIndex == -1) {
-                    outputScene.materials.emplace_back(createMaterialData(material, outputScene));
+                if (materialIndex == 0xffffffff) {
+                    outputScene.materials.emplace_back(createMaterialData(material, graph, outputScene, options));
                     materialIndex = outputScene.materials.size() - 1;
                 }
 
@@ -151,63 +609,409 @@ namespace fbx {
                 std::cout << "Node has no material component." << std::endl;
         }
 
+        return materialIndices;
+    }
 
-        // Check if the node has a mesh component
-        FbxMesh* nodeMesh = node->GetMesh();
-        if (nodeMesh == NULL) {
-            if (DEBUG_OUTPUTS) {
-                std::cout << "Node has no mesh component." << std::endl;
+    namespace {
+        /// <summary>
+        /// Gets the control point referenced by an entry of the PolygonVertexIndex array
+        /// </summary>
+        inline std::int32_t getControlPoint(std::int32_t polygonVertexIndex) {
+            return polygonVertexIndex < 0 ? ~polygonVertexIndex : polygonVertexIndex;
+        }
+
+        /// <summary>
+        /// The values of a LayerElement record, looked up per polygon vertex straight from the file data
+        /// </summary>
+        struct PolygonVertexElement
+        {
+            enum class Mapping { ByPolygonVertex, ByControlPoint, ByPolygon, AllSame };
+
+            ArrayView<double> data;
+            ArrayView<std::int32_t> indices;		// Empty for direct references
+            Mapping mapping = Mapping::ByPolygonVertex;
+            int components = 0;
+
+            /// <summary>
+            /// Gets the index of the first component of the value used by a polygon vertex
+            /// </summary>
+            size_t getValueIndex(size_t polygonVertex, size_t controlPoint, size_t polygon) const {
+                size_t valueIndex = 0;
+                switch (mapping) {
+                case Mapping::ByPolygonVertex: valueIndex = polygonVertex; break;
+                case Mapping::ByControlPoint: valueIndex = controlPoint; break;
+                case Mapping::ByPolygon: valueIndex = polygon; break;
+                case Mapping::AllSame: valueIndex = 0; break;
+                }
+
+                if (!indices.empty()) {
+                    if (valueIndex >= indices.size()) {
+                        throw std::runtime_error("Invalid FBX layer element index.");
+                    }
+                    valueIndex = indices[valueIndex];
+                }
+                if ((valueIndex + 1) * components > data.size()) {
+                    throw std::runtime_error("Invalid FBX layer element index.");
+                }
+                return valueIndex * components;
+            }
+        };
+
+        /// <summary>
+        /// Reads the mapping and arrays of a LayerElement record
+        /// </summary>
+        /// <param name="element">The layer element record (e.g. LayerElementNormal)</param>
+        /// <param name="dataName">The name of the direct array (e.g. Normals)</param>
+        /// <param name="indexName">The name of the index array (e.g. NormalsIndex)</param>
+        /// <param name="components">The number of components per value</param>
+        /// <param name="outElement">The element views</param>
+        /// <returns>False if the element could not be read</returns>
+        bool readPolygonVertexElement(const Node* element, const char* dataName, const char* indexName, int components, PolygonVertexElement& outElement) {
+            if (element == nullptr) {
+                return false;
+            }
+            const Node* dataNode = element->findChild(dataName);
+            const Node* mappingNode = element->findChild("MappingInformationType");
+            const Node* referenceNode = element->findChild("ReferenceInformationType");
+            if (dataNode == nullptr || dataNode->properties.empty() || mappingNode == nullptr || mappingNode->properties.empty()) {
+                return false;
+            }
+
+            std::string_view mapping = mappingNode->properties[0].stringValue;
+            if (mapping == "ByPolygonVertex") {
+                outElement.mapping = PolygonVertexElement::Mapping::ByPolygonVertex;
+            }
+            else if (mapping == "ByControlPoint" || mapping == "ByVertice" || mapping == "ByVertex") {
+                outElement.mapping = PolygonVertexElement::Mapping::ByControlPoint;
+            }
+            else if (mapping == "ByPolygon") {
+                outElement.mapping = PolygonVertexElement::Mapping::ByPolygon;
             }
-            FbxLight* light = node->GetLight();
-            if (light != NULL) {
-                outputScene.lights.emplace_back(createLightData(light, transformMatrix));
+            else if (mapping == "AllSame") {
+                outElement.mapping = PolygonVertexElement::Mapping::AllSame;
             }
+            else {
+                return false;
+            }
+
+            // Index arrays are used by IndexToDirect references
+            if (referenceNode != nullptr && !referenceNode->properties.empty() && referenceNode->properties[0].stringValue != "Direct") {
+                const Node* indexNode = element->findChild(indexName);
+                if (indexNode == nullptr || indexNode->properties.empty()) {
+                    return false;
+                }
+                outElement.indices = indexNode->properties[0].asArray<std::int32_t>();
+            }
+
+            outElement.data = dataNode->properties[0].asArray<double>();
+            outElement.components = components;
+            return true;
         }
-        else {
-            // Create the mesh data
-            outputScene.meshes.emplace_back(createMeshData(nodeMesh, materialIndices, transformMatrix));
-            outputScene.meshes.back().materials = materialIndices;
+
+        /// <summary>
+        /// Generates smooth per control point normals for a mesh without normals
+        /// </summary>
+        std::vector<double> generateNormals(const ArrayView<std::int32_t>& polygonVertexIndices, const ArrayView<double>& controlPoints) {
+            std::vector<glm::dvec3> controlPointNormals(controlPoints.size() / 3, glm::dvec3(0));
+
+            // Accumulate the area weighted polygon normals (Newell's method) on the control points
+            size_t polygonStart = 0;
+            for (size_t i = 0; i < polygonVertexIndices.size(); i++) {
+                if (polygonVertexIndices[i] >= 0) {
+                    continue;
+                }
+                glm::dvec3 polygonNormal(0);
+                for (size_t j = polygonStart; j <= i; j++) {
+                    size_t next = (j == i) ? polygonStart : j + 1;
+                    size_t current = getControlPoint(polygonVertexIndices[j]) * 3;
+                    size_t following = getControlPoint(polygonVertexIndices[next]) * 3;
+                    polygonNormal.x += (controlPoints[current + 1] - controlPoints[following + 1]) * (controlPoints[current + 2] + controlPoints[following + 2]);
+                    polygonNormal.y += (controlPoints[current + 2] - controlPoints[following + 2]) * (controlPoints[current] + controlPoints[following]);
+                    polygonNormal.z += (controlPoints[current] - controlPoints[following]) * (controlPoints[current + 1] + controlPoints[following + 1]);
+                }
+                for (size_t j = polygonStart; j <= i; j++) {
+                    controlPointNormals[getControlPoint(polygonVertexIndices[j])] += polygonNormal;
+                }
+                polygonStart = i + 1;
+            }
+
+            std::vector<double> normals(controlPointNormals.size() * 3);
+            for (size_t i = 0; i < controlPointNormals.size(); i++) {
+                glm::dvec3 normal = controlPointNormals[i];
+                if (glm::length(normal) > 0) {
+                    normal = glm::normalize(normal);
+                }
+                normals[i * 3] = normal.x;
+                normals[i * 3 + 1] = normal.y;
+                normals[i * 3 + 2] = normal.z;
+            }
+            return normals;
+        }
+
+        /// <summary>
+        /// Gets the area weighted normal of a polygon (Newell's method)
+        /// </summary>
+        glm::dvec3 getPolygonNormal(const std::vector<glm::dvec3>& corners) {
+            glm::dvec3 normal(0);
+            for (size_t j = 0; j < corners.size(); j++) {
+                const glm::dvec3& current = corners[j];
+                const glm::dvec3& following = corners[(j + 1) % corners.size()];
+                normal.x += (current.y - following.y) * (current.z + following.z);
+                normal.y += (current.z - following.z) * (current.x + following.x);
+                normal.z += (current.x - following.x) * (current.y + following.y);
+            }
+            return normal;
+        }
+
+        /// <summary>
+        /// Checks that every corner of a polygon turns the same way around its normal
+        /// </summary>
+        bool isConvexPolygon(const std::vector<glm::dvec3>& corners) {
+            glm::dvec3 normal = getPolygonNormal(corners);
+            size_t numCorners = corners.size();
+            for (size_t j = 0; j < numCorners; j++) {
+                const glm::dvec3& previous = corners[(j + numCorners - 1) % numCorners];
+                const glm::dvec3& next = corners[(j + 1) % numCorners];
+                if (glm::dot(glm::cross(corners[j] - previous, next - corners[j]), normal) < 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// <summary>
+        /// Triangulates concave polygons by clipping ears, keeping its buffers between polygons
+        /// </summary>
+        struct EarClipper
+        {
+            std::vector<glm::dvec2> points;
+            std::vector<std::uint32_t> remaining;
+
+            static double cross(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c) {
+                return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            }
+
+            bool isEar(size_t previous, size_t current, size_t next) const {
+                const glm::dvec2& a = points[remaining[previous]];
+                const glm::dvec2& b = points[remaining[current]];
+                const glm::dvec2& c = points[remaining[next]];
+                if (cross(a, b, c) <= 0) {
+                    return false;
+                }
+
+                // No other corner may lie inside the ear
+                for (size_t j = 0; j < remaining.size(); j++) {
+                    if (j == previous || j == current || j == next) {
+                        continue;
+                    }
+                    const glm::dvec2& p = points[remaining[j]];
+                    if (p == a || p == b || p == c) {
+                        continue;
+                    }
+                    if (cross(a, b, p) >= 0 && cross(b, c, p) >= 0 && cross(c, a, p) >= 0) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            /// <summary>
+            /// Adds the triangles of a polygon to a triangulation
+            /// </summary>
+            /// <param name="corners">The corner positions of the polygon</param>
+            /// <param name="polygonStart">The polygon vertex of the first corner</param>
+            /// <param name="polygon">The index of the polygon</param>
+            void triangulate(const std::vector<glm::dvec3>& corners, std::uint32_t polygonStart, std::uint32_t polygon, Triangulation& triangulation) {
+                // Project the polygon onto the plane of its largest normal component
+                glm::dvec3 normal = getPolygonNormal(corners);
+                glm::dvec3 magnitude = glm::abs(normal);
+                int axis = (magnitude.x > magnitude.y && magnitude.x > magnitude.z) ? 0 : (magnitude.y > magnitude.z ? 1 : 2);
+                int u = (axis + 1) % 3;
+                int v = (axis + 2) % 3;
+                double orientation = normal[axis] < 0 ? -1.0 : 1.0;
+
+                // Counter clockwise in the projected plane
+                points.clear();
+                remaining.clear();
+                for (std::uint32_t j = 0; j < corners.size(); j++) {
+                    points.emplace_back(corners[j][u], corners[j][v] * orientation);
+                    remaining.emplace_back(j);
+                }
+
+                auto addTriangle = [&](size_t a, size_t b, size_t c) {
+                    triangulation.polygonVertices.emplace_back(polygonStart + remaining[a]);
+                    triangulation.polygonVertices.emplace_back(polygonStart + remaining[b]);
+                    triangulation.polygonVertices.emplace_back(polygonStart + remaining[c]);
+                    triangulation.trianglePolygons.emplace_back(polygon);
+                };
+
+                size_t current = 0;
+                size_t attempts = 0;
+                while (remaining.size() > 3) {
+                    size_t count = remaining.size();
+                    size_t previous = (current + count - 1) % count;
+                    size_t next = (current + 1) % count;
+                    if (isEar(previous, current, next)) {
+                        addTriangle(previous, current, next);
+                        remaining.erase(remaining.begin() + current);
+                        current = current % remaining.size();
+                        attempts = 0;
+                    }
+                    else if (++attempts > count) {
+                        // Degenerate polygon with no ear left, fan out the rest
+                        for (size_t j = 1; j + 1 < count; j++) {
+                            addTriangle(0, j, j + 1);
+                        }
+                        return;
+                    }
+                    else {
+                        current = next;
+                    }
+                }
+                addTriangle(0, 1, 2);
+            }
+        };
+    }
+
+    Triangulation triangulateMesh(const ArrayView<std::int32_t>& polygonVertexIndices, const ArrayView<double>& controlPoints) {
+        Triangulation triangulation;
+        triangulateMesh(polygonVertexIndices, controlPoints, triangulation);
+        return triangulation;
+    }
+
+    void triangulateMesh(const ArrayView<std::int32_t>& polygonVertexIndices, const ArrayView<double>& controlPoints, Triangulation& triangulation) {
+        triangulation.polygonVertices.clear();
+        triangulation.trianglePolygons.clear();
+
+        // Count the triangles first so the output is only allocated once
+        // The last vertex of each polygon is stored as a negative (bitwise not) index
+        size_t numTriangles = 0;
+        bool allTriangles = true;
+        std::uint32_t polygonStart = 0;
+        for (std::uint32_t i = 0; i < polygonVertexIndices.size(); i++) {
+            if (polygonVertexIndices[i] >= 0) {
+                continue;
+            }
+            std::uint32_t numCorners = i + 1 - polygonStart;
+            numTriangles += numCorners >= 3 ? numCorners - 2 : 0;
+            allTriangles &= numCorners == 3;
+            polygonStart = i + 1;
         }
+        triangulation.polygonVertices.reserve(numTriangles * 3);
+        triangulation.trianglePolygons.reserve(numTriangles);
 
-        // If there is no children do not recurse
-        if (numChildren == 0) {
+        // Meshes which are already triangulated map straight through
+        if (allTriangles && polygonStart == polygonVertexIndices.size()) {
+            for (std::uint32_t i = 0; i < polygonStart; i++) {
+                triangulation.polygonVertices.emplace_back(i);
+            }
+            for (std::uint32_t i = 0; i < numTriangles; i++) {
+                triangulation.trianglePolygons.emplace_back(i);
+            }
             return;
         }
 
-        // Visit all the children of the current node
-        for (int i = 0; i < numChildren; i++) {
-            FbxNode* childNode = node->GetChild(i);
-            getChildren(childNode, outputScene);
+        std::vector<glm::dvec3> corners;
+        EarClipper earClipper;
+        polygonStart = 0;
+        std::uint32_t polygon = 0;
+        for (std::uint32_t i = 0; i < polygonVertexIndices.size(); i++) {
+            if (polygonVertexIndices[i] >= 0) {
+                continue;
+            }
+            std::uint32_t numCorners = i + 1 - polygonStart;
+
+            // Gather the corner positions of polygons which may not be convex
+            bool convex = true;
+            if (numCorners > 3) {
+                corners.clear();
+                for (std::uint32_t j = polygonStart; j <= i; j++) {
+                    size_t controlPoint = (size_t)getControlPoint(polygonVertexIndices[j]) * 3;
+                    if (controlPoint + 2 >= controlPoints.size()) {
+                        throw std::runtime_error("Invalid FBX control point index.");
+                    }
+                    corners.emplace_back(controlPoints[controlPoint], controlPoints[controlPoint + 1], controlPoints[controlPoint + 2]);
+                }
+                convex = isConvexPolygon(corners);
+            }
+
+            if (convex) {
+                // Fan out from the first vertex of the polygon
+                for (std::uint32_t corner = polygonStart + 1; corner + 1 <= i; corner++) {
+                    triangulation.polygonVertices.emplace_back(polygonStart);
+                    triangulation.polygonVertices.emplace_back(corner);
+                    triangulation.polygonVertices.emplace_back(corner + 1);
+                    triangulation.trianglePolygons.emplace_back(polygon);
+                }
+            }
+            else {
+                earClipper.triangulate(corners, polygonStart, polygon, triangulation);
+            }
+
+            polygonStart = i + 1;
+            polygon++;
+        }
+    }
+
+    Mesh readMeshData(const SceneGraph& graph, const Node& inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform, const LoadOptions& options) {
+        MeshBuffers buffers;
+        return readMeshData(graph, inMesh, materialIndices, transform, options, buffers);
+    }
+
+    Mesh readMeshData(const SceneGraph& graph, const Node& inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform, const LoadOptions& options, MeshBuffers& buffers) {
+        if (!inMesh.deferred) {
+            return createMeshData(inMesh, materialIndices, transform, options, buffers);
         }
+
+        // The geometry record (and its decompressed arrays) only lives while the mesh is built
+        Node geometry = readDeferredNode(graph.document, inMesh, getSkippedGeometryRecords(options));
+        return createMeshData(geometry, materialIndices, transform, options, buffers);
+    }
+
+    Mesh createMeshData(const Node& inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform, const LoadOptions& options) {
+        MeshBuffers buffers;
+        return createMeshData(inMesh, materialIndices, transform, options, buffers);
     }
 
-    Mesh createMeshData(FbxMesh* inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform) {
+    Mesh createMeshData(const Node& inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform, const LoadOptions& options, MeshBuffers& buffers) {
         Mesh outMesh;
 
-        // Get the number of triangles in the mesh and all the triangles
-        int numTriangles = inMesh->GetPolygonCount();
+        // Get all the vertices (control points) and polygon vertex indices straight from the file data
+        const Node* verticesNode = inMesh.findChild("Vertices");
+        const Node* indicesNode = inMesh.findChild("PolygonVertexIndex");
+        if (verticesNode == nullptr || indicesNode == nullptr || verticesNode->properties.empty() || indicesNode->properties.empty()) {
+            throw std::runtime_error("Failed to gather mesh vertices.");
+        }
+        ArrayView<double> fbxVertices = verticesNode->properties[0].asArray<double>();
+        ArrayView<std::int32_t> fbxPolygonVertices = indicesNode->properties[0].asArray<std::int32_t>();
 
-        // Get the number of vertices and all vertices
-        int numVertices = inMesh->GetControlPointsCount();
-        FbxVector4* fbxVertices = inMesh->GetControlPoints();
+        // Triangulate the mesh, each triangle corner refers to one of the polygon vertices
+        Triangulation& triangulation = buffers.triangulation;
+        triangulateMesh(fbxPolygonVertices, fbxVertices, triangulation);
 
         // Get the number of indices and all indices
-        int numIndices = inMesh->GetPolygonVertexCount();
-        int* fbxIndices = inMesh->GetPolygonVertices();
+        size_t numIndices = triangulation.polygonVertices.size();
+        std::vector<std::uint32_t>& fbxIndices = triangulation.polygonVertices;
 
         // Get the normals for the mesh
-        FbxArray<FbxVector4> fbxNormals;
+        PolygonVertexElement fbxNormals;
         // Generate the normals (if there is none) and store them
-        if (!(inMesh->GenerateNormals() && inMesh->GetPolygonVertexNormals(fbxNormals))) {
+        if (!options.loadNormals) {
+            // Normals are not needed
+        }
+        else if (inMesh.findChild("LayerElementNormal") == nullptr) {
+            fbxNormals.data = ArrayView<double>(generateNormals(fbxPolygonVertices, fbxVertices));
+            fbxNormals.mapping = PolygonVertexElement::Mapping::ByControlPoint;
+            fbxNormals.components = 3;
+        }
+        else if (!readPolygonVertexElement(inMesh.findChild("LayerElementNormal"), "Normals", "NormalsIndex", 3, fbxNormals)) {
             throw std::runtime_error("Failed to gather mesh normals");
         }
 
         // Get the uvs for the mesh 
         // For now use only the first uv set in the mesh
-        FbxStringList uvSets;
-        inMesh->GetUVSetNames(uvSets);
-        FbxArray<FbxVector2> fbxUVs;
-        if (!inMesh->GetPolygonVertexUVs(uvSets.GetStringAt(0), fbxUVs)) {
+        PolygonVertexElement fbxUVs;
+        if (options.loadTextureCoords && !readPolygonVertexElement(inMesh.findChild("LayerElementUV"), "UV", "UVIndex", 2, fbxUVs)) {
             throw std::runtime_error("Failed to gather mesh texture coordinates.");
         }
 
@@ -215,153 +1019,218 @@ namespace fbx {
         glm::mat4 normalTransform = transform;
         normalTransform[3] = glm::vec4(0, 0, 0, 1);
 
-        std::vector<glm::vec3> positions;
-        std::vector<glm::vec2> uvs;
-        std::vector<glm::vec3> normals;
-        std::vector<uint32_t> materialIDs;
-        std::vector<uint32_t> indices;
+        // Transform every control point and normal once, in batches, rather than every corner that uses them
+        PointArrays& positions = buffers.positions;
+        positions.assign(fbxVertices, fbxVertices.size() / 3);
+        transformPoints(transform, positions);
+
+        PointArrays& normals = buffers.normals;
+        if (options.loadNormals) {
+            normals.assign(fbxNormals.data, fbxNormals.data.size() / 3);
+            transformPoints(normalTransform, normals);
+        }
+
+        // Get the per polygon material indices
+        ArrayView<std::int32_t> materialElement;
+        const Node* materialLayer = inMesh.findChild("LayerElementMaterial");
+        const Node* materialsNode = materialLayer != nullptr ? materialLayer->findChild("Materials") : nullptr;
+        if (options.loadMaterials && materialsNode != nullptr && !materialsNode->properties.empty()) {
+            materialElement = materialsNode->properties[0].asArray<std::int32_t>();
+        }
 
-        // For each index
-        for (int i = 0; i < numIndices; i++) {  
-            // Get the index
-            int index = fbxIndices[i];
+        // The attributes of a triangle corner, read ahead of welding it
+        struct Corner
+        {
+            glm::vec3 position;
+            glm::vec3 normal;
+            glm::vec2 uv;
+            std::uint32_t materialID;
+            VertexKey key;
+        };
+
+        auto readCorner = [&](size_t i, Corner& corner) {
+            // Get the polygon vertex, the control point it uses and the polygon it belongs to
+            std::uint32_t polygonVertex = fbxIndices[i];
+            std::int32_t index = getControlPoint(fbxPolygonVertices[polygonVertex]);
+            std::uint32_t polygon = triangulation.trianglePolygons[i / 3];
+            if ((size_t)index * 3 + 2 >= fbxVertices.size()) {
+                throw std::runtime_error("Invalid FBX control point index.");
+            }
 
             // Get the vertex position
-            glm::vec3 vertex = glm::vec3(fbxVertices[index][0], fbxVertices[index][1], fbxVertices[index][2]);
+            corner.position = positions[index];
 
             // Get the vertex normal
-            glm::vec3 normal = glm::vec3(fbxNormals[i][0], fbxNormals[i][1], fbxNormals[i][2]);
+            if (options.loadNormals) {
+                corner.normal = normals[fbxNormals.getValueIndex(polygonVertex, index, polygon) / 3];
+            }
 
             // Get the vertex texture co-ordinate
-            glm::vec2 uv = glm::vec2(fbxUVs[i][0], fbxUVs[i][1]);
-
-            // Add the new vertex position and normal
-            positions.emplace_back(transform * glm::vec4(vertex, 1));
-            normals.emplace_back(normalTransform * glm::vec4(normal, 1));
-            uvs.emplace_back(uv);
+            if (options.loadTextureCoords) {
+                size_t uvIndex = fbxUVs.getValueIndex(polygonVertex, index, polygon);
+                corner.uv = glm::vec2(fbxUVs.data[uvIndex], fbxUVs.data[uvIndex + 1]);
+            }
 
-            // Store the newly assigned index
-            indices.emplace_back(i);
-        }
+            // Material index for the polygon the triangle came from (AllSame mapping only stores one)
+            if (options.loadMaterials) {
+                std::int32_t materialIndex = materialElement.empty() ? 0 : materialElement[polygon < materialElement.size() ? polygon : 0];
+                corner.materialID = ((size_t)materialIndex < materialIndices.size()) ? materialIndices[materialIndex] : 0xffffffff;
+            }
 
-        // Calculate the per polygon material ids
-        FbxLayerElementMaterial* materialElement = inMesh->GetElementMaterial();
-        for (int i = 0; i < inMesh->GetPolygonCount(); i++) {
-            // Material index for the current polygon
-            int materialIndex = materialElement->GetIndexArray().GetAt(i);
-            materialIDs.emplace_back(materialIndices[materialIndex]);
-            materialIDs.emplace_back(materialIndices[materialIndex]);
-            materialIDs.emplace_back(materialIndices[materialIndex]);
+            corner.key = makeVertexKey(corner.position,
+                options.loadNormals ? &corner.normal : nullptr,
+                options.loadTextureCoords ? &corner.uv : nullptr,
+                options.loadMaterials ? &corner.materialID : nullptr);
+        };
+
+        VertexWelder& welder = buffers.welder;
+        if (VertexWelder::useSortedWeld(numIndices, options.weldTolerances)) {
+            // Very large meshes are welded by sorting on the pool. Corners are read again whenever they are
+            // needed rather than kept, then the vertices copy the data of their first corners in parallel.
+            std::vector<std::uint32_t>& vertexSources = buffers.vertexSources;
+            welder.weldSorted(numIndices, [&](size_t i) {
+                Corner corner;
+                readCorner(i, corner);
+                return corner.key;
+            }, outMesh.vertexIndices, vertexSources);
+
+            size_t numVertices = vertexSources.size();
+            outMesh.vertexPositions.resize(numVertices);
+            if (options.loadNormals)
+                outMesh.vertexNormals.resize(numVertices);
+            if (options.loadTextureCoords)
+                outMesh.vertexTextureCoords.resize(numVertices);
+            if (options.loadMaterials)
+                outMesh.vertexMaterialIDs.resize(numVertices);
+
+            const size_t vertexBlock = 1 << 16;
+            ThreadPool::shared().parallelFor((numVertices + vertexBlock - 1) / vertexBlock, [&](size_t block) {
+                size_t end = std::min(numVertices, (block + 1) * vertexBlock);
+                for (size_t vertex = block * vertexBlock; vertex < end; vertex++) {
+                    Corner corner;
+                    readCorner(vertexSources[vertex], corner);
+                    outMesh.vertexPositions[vertex] = corner.position;
+                    if (options.loadNormals)
+                        outMesh.vertexNormals[vertex] = corner.normal;
+                    if (options.loadTextureCoords)
+                        outMesh.vertexTextureCoords[vertex] = corner.uv;
+                    if (options.loadMaterials)
+                        outMesh.vertexMaterialIDs[vertex] = corner.materialID;
+                }
+            });
         }
-
-        // Check if the mesh will benefit from redoing the indices
-        // Check for duplicate vertices and re-index them
-
-        
-        std::vector<int> seenIndex(indices.size(), -1);
-        std::unordered_map<glm::vec3, std::pair<uint32_t, uint32_t>> seenVertices;
-        std::vector<std::vector<std::uint32_t>> samePositionsArray;
-
-        for (size_t i = 0; i < indices.size(); i++) {
-            uint32_t index = indices[i];
-
-            // If index has already been seen and re-indexed, use that one
-            if (seenIndex[index] != -1) {
-                outMesh.vertexIndices.emplace_back(seenIndex[index]);
+        else {
+            // The vertex count is only known at the end, most meshes have about as many vertices as control points
+            size_t expectedVertices = std::min(numIndices, fbxVertices.size() / 3);
+            outMesh.vertexIndices.reserve(numIndices);
+            outMesh.vertexPositions.reserve(expectedVertices);
+            if (options.loadNormals)
+                outMesh.vertexNormals.reserve(expectedVertices);
+            if (options.loadTextureCoords)
+                outMesh.vertexTextureCoords.reserve(expectedVertices);
+            if (options.loadMaterials)
+                outMesh.vertexMaterialIDs.reserve(expectedVertices);
+
+            // Weld each corner as it is read and write the new vertices straight into the mesh.
+            // The corners are read a few ahead so the welder can fetch their table slots in time.
+            welder.begin(numIndices, options.weldTolerances);
+            const size_t readAhead = VertexWelder::prefetchDistance;
+            Corner pending[readAhead];
+            for (size_t i = 0; i < readAhead && i < numIndices; i++) {
+                readCorner(i, pending[i]);
+                welder.prefetch(pending[i].key);
             }
-            // Index has not been found so find the vertex and re-index accordingly
-            else {
-                // Check if that position has been seen before
-                if (seenVertices.find(positions[index]) == seenVertices.end()) {
-                    // New position found
-                    // Add the new vertex position normal and uv
-                    outMesh.vertexPositions.emplace_back(glm::vec4(positions[index], 1));
-                    outMesh.vertexNormals.emplace_back(glm::vec4(normals[index], 1));
-                    outMesh.vertexTextureCoords.emplace_back(uvs[index]);
-                    outMesh.vertexMaterialIDs.emplace_back(materialIDs[index]);
-
-                    // Store the newly assigned index
-                    std::uint32_t newIndex = outMesh.vertexPositions.size() - 1;
-                    outMesh.vertexIndices.emplace_back(newIndex);
-
-                    // Add it to the map of seen vertices
-                    samePositionsArray.emplace_back(std::vector<std::uint32_t>());
-                    samePositionsArray[samePositionsArray.size() - 1].emplace_back(newIndex);
-                    
-                    seenVertices[positions[index]] = std::pair<uint32_t, uint32_t>(newIndex, samePositionsArray.size() - 1);
-
-                    // Note that the index has been seen and remapped to a new index
-                    seenIndex[index] = newIndex;
-                }
-                else {
-                    // Position already exists
-                    // Get the already assigned index
-                    std::uint32_t newIndex = seenVertices.at(positions[index]).first;
-                    std::uint32_t vertexID = seenVertices.at(positions[index]).second;
-
-                    // Check that the uvs, normals and materials match up as well
-                    if ((outMesh.vertexTextureCoords[newIndex] != uvs[index]) || 
-                        outMesh.vertexNormals[newIndex] != normals[index] ||
-                        outMesh.vertexMaterialIDs[newIndex] != materialIDs[index]) {
-                        // If uvs or normals do not match
-                        // Add to index array as if its a new vertex
-                        outMesh.vertexPositions.emplace_back(glm::vec4(positions[index], 1));
-                        outMesh.vertexNormals.emplace_back(glm::vec4(normals[index], 1));
-                        outMesh.vertexTextureCoords.emplace_back(uvs[index]);
-                        outMesh.vertexMaterialIDs.emplace_back(materialIDs[index]);
-
-                        // Store the newly assigned index
-                        std::uint32_t oldIndex = newIndex;
-                        newIndex = outMesh.vertexPositions.size() - 1;
-                        outMesh.vertexIndices.emplace_back(newIndex);
-
-                        // Map the new index to the vertex
-                        samePositionsArray[vertexID].emplace_back(newIndex);
 
-                    }
-                    else {
-                        // Identical index so remap and store the index only
-                        // Store the index
-                        outMesh.vertexIndices.emplace_back(newIndex);
+            for (size_t i = 0; i < numIndices; i++) {
+                Corner& corner = pending[i % readAhead];
+                bool isNewVertex;
+                outMesh.vertexIndices.emplace_back(welder.add(corner.key, isNewVertex));
+                if (isNewVertex) {
+                    outMesh.vertexPositions.emplace_back(corner.position);
+                    if (options.loadNormals)
+                        outMesh.vertexNormals.emplace_back(corner.normal);
+                    if (options.loadTextureCoords)
+                        outMesh.vertexTextureCoords.emplace_back(corner.uv);
+                    if (options.loadMaterials)
+                        outMesh.vertexMaterialIDs.emplace_back(corner.materialID);
+                }
 
-                        // Map the new index to the seen indices
-                        seenIndex[index] = newIndex;
-                    }                    
+                if (i + readAhead < numIndices) {
+                    readCorner(i + readAhead, corner);
+                    welder.prefetch(corner.key);
                 }
             }
         }
-        
+
+        // Give back the memory reserved for vertices that were merged away, when it is worth a copy
+        auto fitVertices = [](auto& values) {
+            if (values.capacity() > values.size() + values.size() / 4) {
+                values.shrink_to_fit();
+            }
+        };
+        fitVertices(outMesh.vertexPositions);
+        fitVertices(outMesh.vertexNormals);
+        fitVertices(outMesh.vertexTextureCoords);
+        fitVertices(outMesh.vertexMaterialIDs);
+
         // Calculate the per vertex tangents
-        outMesh.vertexTangents = calculateTangents(outMesh.vertexIndices, outMesh.vertexPositions, outMesh.vertexTextureCoords, outMesh.vertexNormals);
+        if (options.loadTangents && options.loadNormals && options.loadTextureCoords) {
+            outMesh.vertexTangents = calculateTangents(outMesh.vertexIndices, outMesh.vertexPositions, outMesh.vertexTextureCoords, outMesh.vertexNormals);
+        }
+
+        if (options.quantizeVertices) {
+            // The material IDs are quantized to indices into the mesh materials
+            outMesh.materials = materialIndices;
+            quantizeMesh(outMesh);
+        }
 
         return outMesh;
     }
 
-    Material createMaterialData(FbxSurfaceMaterial* inMaterial, Scene& outputScene) {
+    Material createMaterialData(const Node& inMaterial, const SceneGraph& graph, Scene& outputScene, const LoadOptions& options) {
         Material outMaterial;
 
         // Get the material name and place it in the struct
-        outMaterial.materialName = inMaterial->GetName();
-
-        if (inMaterial->GetClassId().Is(FbxSurfacePhong::ClassId)) {
+        outMaterial.materialName = getObjectName(inMaterial);
+
+        // The shading model decides the material class
+        std::string shadingModel;
+        if (const Node* shadingModelNode = inMaterial.findChild("ShadingModel")) {
+            if (!shadingModelNode->properties.empty()) {
+                shadingModel = std::string(shadingModelNode->properties[0].stringValue);
+                for (char& c : shadingModel) {
+                    c = (char)std::tolower((unsigned char)c);
+                }
+            }
+        }
+        std::int64_t materialID = inMaterial.properties[0].asInteger();
+
+        if (shadingModel == "phong" && !options.loadTextures) {
+            // Textures are skipped so leave the texture sets untouched
+            outMaterial.diffuseTextureID = 0xffffffff;
+            outMaterial.specularTextureID = 0xffffffff;
+            outMaterial.normalTextureID = 0xffffffff;
+            outMaterial.emissiveTextureID = 0xffffffff;
+        }
+        else if (shadingModel == "phong") {
             /* DEBUG LINE */
             if (DEBUG_OUTPUTS)
                 std::cout << "Phong available" << std::endl;
 
-            // Get the material as a phong material
-            FbxSurfacePhong* phongMaterial = ((FbxSurfacePhong*)inMaterial);
+            // Get the textures connected to the phong material properties
+            auto getTexture = [&](const char* property) -> const Node* {
+                const Node* texture = graph.findSourceObject(materialID, property);
+                return (texture != nullptr && texture->name == "Texture") ? texture : nullptr;
+            };
 
             // Check for diffuse texture
-            if (phongMaterial->Diffuse.GetSrcObject(0)) {
+            if (const Node* diffuseTexture = getTexture("DiffuseColor")) {
                 // There is a diffuse texture
-                FbxFileTexture* diffuseTexture = ((FbxFileTexture*)phongMaterial->Diffuse.GetSrcObject(0));
-
                 // Add the index to the material
-                outMaterial.diffuseTextureID = createTexture(diffuseTexture, outputScene.diffuseTextures);
+                outMaterial.diffuseTextureID = createTexture(*diffuseTexture, outputScene.diffuseTextures);
 
                 // Check if the diffuse texture is alpha mapped
-                FbxTexture* alphaTexture = ((FbxTexture*)phongMaterial->Diffuse.GetSrcObject(0));
-                if (alphaTexture->Alpha < 1) {
+                if (graph.getNumber(*diffuseTexture, "FbxFileTexture", "Texture alpha", 1) < 1) {
                     outMaterial.isAlphaMapped = true;
                 }
             }
@@ -376,12 +1245,10 @@ namespace fbx {
 
             // NOTE: The specular is the roughness and metalness
             // Check for specular texture
-            if (phongMaterial->Specular.GetSrcObject(0)) {
+            if (const Node* specularTexture = getTexture("SpecularColor")) {
                 // There is a specular texture
-                FbxFileTexture* specularTexture = ((FbxFileTexture*)phongMaterial->Specular.GetSrcObject(0));
-
                 // Add the index to the material
-                outMaterial.specularTextureID = createTexture(specularTexture, outputScene.specularTextures);
+                outMaterial.specularTextureID = createTexture(*specularTexture, outputScene.specularTextures);
             }
             else {
                 // Place an empty texture in the array so it is aligned with material index
@@ -393,12 +1260,10 @@ namespace fbx {
             }
 
             // Check for normal texture
-            if (phongMaterial->NormalMap.GetSrcObject(0)) {
+            if (const Node* normalTexture = getTexture("NormalMap")) {
                 // There is a specular texture
-                FbxFileTexture* normalTexture = ((FbxFileTexture*)phongMaterial->NormalMap.GetSrcObject(0));
-
                 // Add the index to the material
-                outMaterial.normalTextureID = createTexture(normalTexture, outputScene.normalTextures);
+                outMaterial.normalTextureID = createTexture(*normalTexture, outputScene.normalTextures);
             }
             else {
                 // Place an empty texture in the array so it is aligned with material index
@@ -410,12 +1275,10 @@ namespace fbx {
             }
 
             // Check for emissive texture
-            if (phongMaterial->Emissive.GetSrcObject(0)) {
+            if (const Node* emissiveTexture = getTexture("EmissiveColor")) {
                 // There is a specular texture
-                FbxFileTexture* emissiveTexture = ((FbxFileTexture*)phongMaterial->Emissive.GetSrcObject(0));
-
                 // Add the index to the material
-                outMaterial.emissiveTextureID = createTexture(emissiveTexture, outputScene.emissiveTextures);
+                outMaterial.emissiveTextureID = createTexture(*emissiveTexture, outputScene.emissiveTextures);
             }
             else {
                 // Place an empty texture in the array so it is aligned with material index
@@ -427,7 +1290,7 @@ namespace fbx {
             }
 
         }
-        else if (inMaterial->GetClassId().Is(FbxSurfaceLambert::ClassId)) {
+        else if (shadingModel == "lambert") {
             if (DEBUG_OUTPUTS)
                 std::cout << "Lambertian available" << std::endl;
         }
@@ -439,15 +1302,22 @@ namespace fbx {
         return outMaterial;
     }
 
-    std::uint32_t createTexture(FbxFileTexture* texture, std::vector<Texture>& textureSet) {
+    std::uint32_t createTexture(const Node& texture, std::vector<Texture>& textureSet) {
+        // Get the absolute file name of the texture
+        std::string fileName;
+        const Node* fileNameNode = texture.findChild("FileName");
+        if (fileNameNode != nullptr && !fileNameNode->properties.empty()) {
+            fileName = std::string(fileNameNode->properties[0].stringValue);
+        }
+
         /* DEBUG LINE */
         if (DEBUG_OUTPUTS)
-            std::cout << texture->GetFileName() << std::endl;
+            std::cout << fileName << std::endl;
 
         // Check if the texture already exists in the output scene
         int textureIndex = -1;
         for (size_t i = 0; i < textureSet.size(); i++) {
-            if (textureSet[i].filePath == texture->GetFileName()) {
+            if (textureSet[i].filePath == fileName) {
                 return i;
             }
         }
@@ -455,7 +1325,7 @@ namespace fbx {
         // If texture index has not been found create texture and add it to the output
         if (textureIndex == -1) {
             Texture newTexture;
-            newTexture.filePath = texture->GetFileName();
+            newTexture.filePath = fileName;
             textureSet.emplace_back(newTexture);
             // Remember the ID
             textureIndex = textureSet.size() - 1;
@@ -464,19 +1334,21 @@ namespace fbx {
         return textureIndex;
     }
 
-    Light createLightData(FbxLight* inLight, glm::mat4 transform) {
+    Light createLightData(const Node& inLight, const SceneGraph& graph, glm::mat4 transform) {
         Light outLight;
 
         // The location of the light is simply defined by the transform matrix
         outLight.location = transform[3];
 
         // Get the light colour
-        FbxDouble3 colour = inLight->Color.Get();
-        outLight.colour = glm::vec3(colour[0], colour[1], colour[2]);
+        glm::dvec3 colour = graph.getVector(inLight, "FbxLight", "Color", glm::dvec3(1));
+        outLight.colour = glm::vec3(colour);
 
         // Get the direction of the light if its a directional light
-        if (inLight->LightType.Get() == FbxLight::eSpot ||
-            inLight->LightType.Get() == FbxLight::eDirectional) {
+        // Light types are 0 for point, 1 for directional and 2 for spot
+        int lightType = (int)graph.getNumber(inLight, "FbxLight", "LightType", 0);
+        if (lightType == 2 ||
+            lightType == 1) {
             // It is not a point light
             outLight.isPointLight = false;
 
@@ -553,6 +1425,7 @@ namespace fbx {
 
         // Average the tangents for all vertices
         std::vector<glm::vec4> tangents;
+        tangents.reserve(vTangents.size());
         for (size_t i = 0; i < vTangents.size(); i++) {
             glm::vec3 normal = normals[i];
 
@@ -577,4 +1450,293 @@ namespace fbx {
 
     }
 
+    namespace {
+        static_assert(sizeof(glm::u16vec3) == 6 && sizeof(glm::u16vec2) == 4 && sizeof(glm::i16vec2) == 4,
+            "The quantized vertex data is tightly packed.");
+
+        template<typename T>
+        void freeVector(std::vector<T>& values) {
+            std::vector<T>().swap(values);
+        }
+
+        /// <summary>
+        /// Gets the smallest and largest value of each component
+        /// </summary>
+        template<typename Vector>
+        std::pair<Vector, Vector> getBounds(const std::vector<Vector>& values) {
+            Vector lower = values.empty() ? Vector(0.0f) : values[0];
+            Vector upper = lower;
+            for (const Vector& value : values) {
+                lower = glm::min(lower, value);
+                upper = glm::max(upper, value);
+            }
+            return { lower, upper };
+        }
+
+        /// <summary>
+        /// Maps interleaved vectors to unorm16 across their bounds, 8 vectors at a time when SSE2 is available
+        /// </summary>
+        /// <param name="values">The vector components, count vectors of the given number of components</param>
+        /// <param name="offset">The lower bound of each component</param>
+        /// <param name="invScale">65535 over the extent of each component (0 for no extent)</param>
+        /// <param name="output">The quantized components</param>
+        void quantizeUnorm16(const float* values, size_t count, int components, const float* offset, const float* invScale, std::uint16_t* output) {
+            size_t numValues = count * components;
+            size_t i = 0;
+#ifdef FBX_LOADER_SSE2
+            // 4 vectors fill a whole number of registers, so the component of each lane repeats every
+            // components registers
+            __m128 offsets[4], scales[4];
+            for (int r = 0; r < components; r++) {
+                float laneOffsets[4], laneScales[4];
+                for (int lane = 0; lane < 4; lane++) {
+                    laneOffsets[lane] = offset[(r * 4 + lane) % components];
+                    laneScales[lane] = invScale[(r * 4 + lane) % components];
+                }
+                offsets[r] = _mm_loadu_ps(laneOffsets);
+                scales[r] = _mm_loadu_ps(laneScales);
+            }
+
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 maximum = _mm_set1_ps(65535.0f);
+            const __m128i bias = _mm_set1_epi32(32768);
+            const __m128i flip = _mm_set1_epi16((short)0x8000);
+            auto quantize = [&](size_t index, int r) {
+                __m128 value = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + index), offsets[r]), scales[r]);
+                value = _mm_min_ps(_mm_max_ps(value, zero), maximum);
+                // SSE2 can only pack signed values, so shift into the int16 range and back
+                return _mm_sub_epi32(_mm_cvtps_epi32(value), bias);
+            };
+
+            for (; i + 8 * components <= numValues; i += 8 * components) {
+                for (int r = 0; r < 2 * components; r += 2) {
+                    __m128i packed = _mm_packs_epi32(quantize(i + r * 4, r % components), quantize(i + r * 4 + 4, (r + 1) % components));
+                    _mm_storeu_si128((__m128i*)(output + i + r * 4), _mm_xor_si128(packed, flip));
+                }
+            }
+#endif
+
+            // Scalar quantization for the tail (or all of it without SSE2)
+            for (; i < numValues; i++) {
+                int component = (int)(i % components);
+                float value = (values[i] - offset[component]) * invScale[component];
+                output[i] = (std::uint16_t)std::lrint(std::clamp(value, 0.0f, 65535.0f));
+            }
+        }
+
+        /// <summary>
+        /// Quantizes vectors to unorm16 across their bounds, storing the offset and scale to restore them
+        /// </summary>
+        template<typename Vector, typename Quantized>
+        void quantizeVectors(const std::vector<Vector>& values, Vector& outOffset, Vector& outScale, std::vector<Quantized>& output) {
+            auto [lower, upper] = getBounds(values);
+            Vector extent = upper - lower;
+            Vector invScale;
+            for (int c = 0; c < Vector::length(); c++) {
+                invScale[c] = extent[c] > 0.0f ? 65535.0f / extent[c] : 0.0f;
+            }
+            outOffset = lower;
+            outScale = extent / 65535.0f;
+
+            output.resize(values.size());
+            quantizeUnorm16((const float*)values.data(), values.size(), Vector::length(), &lower[0], &invScale[0], (std::uint16_t*)output.data());
+        }
+
+        inline std::int16_t toSnorm16(float value) {
+            return (std::int16_t)std::lrint(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+        }
+
+        /// <summary>
+        /// Maps a direction onto the octahedron |x| + |y| + |z| = 1, folding the lower half over the upper one.
+        /// Zero and non finite directions are encoded as 0.
+        /// </summary>
+        glm::i16vec2 encodeOctahedral(const glm::vec3& direction) {
+            float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+            if (!(length > 0.0f) || std::isinf(length)) {
+                return glm::i16vec2(0);
+            }
+            glm::vec2 point = glm::vec2(direction) / length;
+            if (direction.z < 0.0f) {
+                glm::vec2 sign(point.x >= 0.0f ? 1.0f : -1.0f, point.y >= 0.0f ? 1.0f : -1.0f);
+                point = (1.0f - glm::abs(glm::vec2(point.y, point.x))) * sign;
+            }
+            return glm::i16vec2(toSnorm16(point.x), toSnorm16(point.y));
+        }
+
+        /// <summary>
+        /// Encodes directions with encodeOctahedral, 4 at a time when SSE2 is available. The vector
+        /// steps round the same way as the scalar ones, so both give the same values.
+        /// </summary>
+        /// <param name="directions">The direction components, x, y and z at the start of every stride floats</param>
+        /// <param name="count">The number of directions</param>
+        /// <param name="stride">The floats per direction, 3 for vec3 or 4 for vec4</param>
+        /// <param name="output">The encoded directions</param>
+        void encodeOctahedral(const float* directions, size_t count, int stride, glm::i16vec2* output) {
+            size_t i = 0;
+#ifdef FBX_LOADER_SSE2
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 minusOne = _mm_set1_ps(-1.0f);
+            const __m128 infinity = _mm_set1_ps(std::numeric_limits<float>::infinity());
+            const __m128 signBit = _mm_set1_ps(-0.0f);
+            const __m128 snormScale = _mm_set1_ps(32767.0f);
+            auto select = [](__m128 mask, __m128 a, __m128 b) {
+                return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+            };
+
+            for (; i + 4 <= count; i += 4) {
+                // Split 4 directions into x, y and z registers
+                const float* input = directions + i * stride;
+                __m128 x, y, z;
+                if (stride == 4) {
+                    __m128 w;
+                    x = _mm_loadu_ps(input);
+                    y = _mm_loadu_ps(input + 4);
+                    z = _mm_loadu_ps(input + 8);
+                    w = _mm_loadu_ps(input + 12);
+                    _MM_TRANSPOSE4_PS(x, y, z, w);
+                }
+                else {
+                    // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+                    __m128 a = _mm_loadu_ps(input);
+                    __m128 b = _mm_loadu_ps(input + 4);
+                    __m128 c = _mm_loadu_ps(input + 8);
+                    x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2)), _MM_SHUFFLE(3, 0, 3, 0));
+                    y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+                    z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+                }
+
+                __m128 length = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signBit, x), _mm_andnot_ps(signBit, y)), _mm_andnot_ps(signBit, z));
+                __m128 valid = _mm_and_ps(_mm_cmpgt_ps(length, zero), _mm_cmplt_ps(length, infinity));
+                __m128 pointX = _mm_div_ps(x, length);
+                __m128 pointY = _mm_div_ps(y, length);
+
+                // Fold the lower half, the sign is -1 for negative values and 1 otherwise
+                __m128 signX = _mm_or_ps(one, _mm_and_ps(_mm_cmplt_ps(pointX, zero), signBit));
+                __m128 signY = _mm_or_ps(one, _mm_and_ps(_mm_cmplt_ps(pointY, zero), signBit));
+                __m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, pointY)), signX);
+                __m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signBit, pointX)), signY);
+                __m128 fold = _mm_cmplt_ps(z, zero);
+                pointX = select(fold, foldedX, pointX);
+                pointY = select(fold, foldedY, pointY);
+
+                // Round to snorm16 like toSnorm16, then interleave the x and y values
+                __m128i snormX = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(pointX, minusOne), one), snormScale));
+                __m128i snormY = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(pointY, minusOne), one), snormScale));
+                snormX = _mm_and_si128(snormX, _mm_castps_si128(valid));
+                snormY = _mm_and_si128(snormY, _mm_castps_si128(valid));
+                __m128i packed = _mm_packs_epi32(_mm_unpacklo_epi32(snormX, snormY), _mm_unpackhi_epi32(snormX, snormY));
+                _mm_storeu_si128((__m128i*)(output + i), packed);
+            }
+#endif
+
+            // Scalar encoding for the tail (or all of it without SSE2)
+            for (; i < count; i++) {
+                const float* direction = directions + i * stride;
+                output[i] = encodeOctahedral(glm::vec3(direction[0], direction[1], direction[2]));
+            }
+        }
+
+        glm::vec3 decodeOctahedral(float x, float y) {
+            glm::vec3 direction(x, y, 1.0f - std::abs(x) - std::abs(y));
+            float fold = std::max(-direction.z, 0.0f);
+            direction.x += direction.x >= 0.0f ? -fold : fold;
+            direction.y += direction.y >= 0.0f ? -fold : fold;
+            return glm::normalize(direction);
+        }
+    }
+
+    void quantizeMesh(Mesh& mesh) {
+        QuantizedVertices& quantized = mesh.quantized;
+
+        quantizeVectors(mesh.vertexPositions, quantized.positionOffset, quantized.positionScale, quantized.vertexPositions);
+        freeVector(mesh.vertexPositions);
+
+        quantizeVectors(mesh.vertexTextureCoords, quantized.textureCoordOffset, quantized.textureCoordScale, quantized.vertexTextureCoords);
+        freeVector(mesh.vertexTextureCoords);
+
+        quantized.vertexNormals.resize(mesh.vertexNormals.size());
+        encodeOctahedral((const float*)mesh.vertexNormals.data(), mesh.vertexNormals.size(), 3, quantized.vertexNormals.data());
+        freeVector(mesh.vertexNormals);
+
+        // The handedness takes the place of the lowest bit of y
+        quantized.vertexTangents.resize(mesh.vertexTangents.size());
+        encodeOctahedral((const float*)mesh.vertexTangents.data(), mesh.vertexTangents.size(), 4, quantized.vertexTangents.data());
+        for (size_t i = 0; i < mesh.vertexTangents.size(); i++) {
+            glm::i16vec2& tangent = quantized.vertexTangents[i];
+            tangent.y = (std::int16_t)((tangent.y & ~1) | (mesh.vertexTangents[i].w < 0.0f ? 1 : 0));
+        }
+        freeVector(mesh.vertexTangents);
+
+        // The material IDs become indices into the mesh materials, the last value is kept for none
+        if (!mesh.vertexMaterialIDs.empty()) {
+            size_t numMaterials = mesh.materials.size();
+            if (numMaterials >= 0xffff) {
+                throw std::runtime_error("Too many materials on a mesh to quantize its material IDs.");
+            }
+            std::uint32_t none = numMaterials < 0xff ? 0xff : 0xffff;
+
+            std::vector<std::uint32_t> localIDs(mesh.vertexMaterialIDs.size());
+            std::uint32_t lastID = 0xffffffff, lastLocalID = none;
+            for (size_t i = 0; i < localIDs.size(); i++) {
+                // Neighbouring vertices mostly share a material
+                std::uint32_t materialID = mesh.vertexMaterialIDs[i];
+                if (materialID != lastID) {
+                    lastID = materialID;
+                    auto found = std::find(mesh.materials.begin(), mesh.materials.end(), materialID);
+                    lastLocalID = found != mesh.materials.end() ? (std::uint32_t)(found - mesh.materials.begin()) : none;
+                }
+                localIDs[i] = lastLocalID;
+            }
+
+            if (none == 0xff) {
+                quantized.vertexMaterialIDs8.assign(localIDs.begin(), localIDs.end());
+            }
+            else {
+                quantized.vertexMaterialIDs16.assign(localIDs.begin(), localIDs.end());
+            }
+        }
+        freeVector(mesh.vertexMaterialIDs);
+    }
+
+    void dequantizeMesh(Mesh& mesh) {
+        QuantizedVertices& quantized = mesh.quantized;
+
+        mesh.vertexPositions.resize(quantized.vertexPositions.size());
+        for (size_t i = 0; i < quantized.vertexPositions.size(); i++) {
+            mesh.vertexPositions[i] = quantized.positionOffset + glm::vec3(quantized.vertexPositions[i]) * quantized.positionScale;
+        }
+
+        mesh.vertexTextureCoords.resize(quantized.vertexTextureCoords.size());
+        for (size_t i = 0; i < quantized.vertexTextureCoords.size(); i++) {
+            mesh.vertexTextureCoords[i] = quantized.textureCoordOffset + glm::vec2(quantized.vertexTextureCoords[i]) * quantized.textureCoordScale;
+        }
+
+        mesh.vertexNormals.resize(quantized.vertexNormals.size());
+        for (size_t i = 0; i < quantized.vertexNormals.size(); i++) {
+            glm::vec2 normal = glm::vec2(quantized.vertexNormals[i]) / 32767.0f;
+            mesh.vertexNormals[i] = decodeOctahedral(normal.x, normal.y);
+        }
+
+        mesh.vertexTangents.resize(quantized.vertexTangents.size());
+        for (size_t i = 0; i < quantized.vertexTangents.size(); i++) {
+            glm::i16vec2 tangent = quantized.vertexTangents[i];
+            float handedness = (tangent.y & 1) ? -1.0f : 1.0f;
+            glm::vec3 direction = decodeOctahedral(tangent.x / 32767.0f, (tangent.y & ~1) / 32767.0f);
+            mesh.vertexTangents[i] = glm::vec4(direction, handedness);
+        }
+
+        auto getMaterialID = [&](std::uint32_t localID) {
+            return localID < mesh.materials.size() ? mesh.materials[localID] : 0xffffffff;
+        };
+        mesh.vertexMaterialIDs.clear();
+        for (std::uint8_t localID : quantized.vertexMaterialIDs8) {
+            mesh.vertexMaterialIDs.emplace_back(getMaterialID(localID));
+        }
+        for (std::uint16_t localID : quantized.vertexMaterialIDs16) {
+            mesh.vertexMaterialIDs.emplace_back(getMaterialID(localID));
+        }
+
+        quantized = QuantizedVertices();
+    }
 }
\ No newline at end of file
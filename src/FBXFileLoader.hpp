@@ -1,9 +1,19 @@
 #pragma once
+#include <atomic>
 #include <vector>
+#include <string>
 #include <functional>
+#include <future>
+#include <memory>
+#include <span>
+#include <istream>
+#include <unordered_map>
 
 #include <glm.hpp>
-#include <fbxsdk.h>
+#include <gtc/type_precision.hpp>
+
+#include "FBXSceneGraph.hpp"
+#include "FBXVertexWelder.hpp"
 
 /// A set of structs used to hold the information from the FBX file.
 namespace fbx {
@@ -33,6 +43,28 @@ namespace fbx {
 
 	};
 
+	/// <summary>
+	/// The vertex data of a mesh in a compact form, filled instead of the float vertex data
+	/// when LoadOptions::quantizeVertices is set. Use dequantizeMesh to get the float data back.
+	/// </summary>
+	struct QuantizedVertices
+	{
+		// Positions and texture coordinates are unorm16 across the bounds of the mesh: value = offset + stored * scale
+		glm::vec3 positionOffset = glm::vec3(0.0f);
+		glm::vec3 positionScale = glm::vec3(0.0f);
+		glm::vec2 textureCoordOffset = glm::vec2(0.0f);
+		glm::vec2 textureCoordScale = glm::vec2(0.0f);
+
+		std::vector<glm::u16vec3> vertexPositions;
+		std::vector<glm::u16vec2> vertexTextureCoords;
+		std::vector<glm::i16vec2> vertexNormals;		// Octahedral snorm16
+		std::vector<glm::i16vec2> vertexTangents;		// Octahedral snorm16, the lowest bit of y is set when the bitangent handedness is -1
+
+		// Indices into the mesh materials (0xff / 0xffff for none), 8 bit when the mesh has fewer than 255 materials
+		std::vector<std::uint8_t> vertexMaterialIDs8;
+		std::vector<std::uint16_t> vertexMaterialIDs16;
+	};
+
 	/// <summary>
 	/// Data for a mesh within a scene
 	/// </summary>
@@ -53,6 +85,9 @@ namespace fbx {
 
 		// Per index variables
 		std::vector<uint32_t> vertexIndices;
+
+		// Only filled when the vertices are quantized, the per vertex variables above are then empty
+		QuantizedVertices quantized;
 	};
 
 	/// <summary>
@@ -67,12 +102,22 @@ namespace fbx {
 		glm::mat4 direction;
 	};
 
+	/// <summary>
+	/// A placement of a mesh in the scene, only filled when geometry is instanced
+	/// </summary>
+	struct MeshInstance
+	{
+		uint32_t meshID;
+		glm::mat4 transform;		// From the mesh's local space to world space
+	};
+
 	/// <summary>
 	/// Data contained in a scene
 	/// </summary>
 	struct Scene
 	{
 		std::vector<Mesh> meshes;
+		std::vector<MeshInstance> instances;
 		std::vector<Material> materials;
 		std::vector<Texture> diffuseTextures;
 		std::vector<Texture> specularTextures;
@@ -81,52 +126,456 @@ namespace fbx {
 		std::vector<Light> lights;
 	};
 
+	/// <summary>
+	/// Controls which parts of a file are loaded. Skipped data is never parsed or converted.
+	/// </summary>
+	struct LoadOptions
+	{
+		bool loadLights = true;
+		bool loadMaterials = true;		// Also controls the per vertex material IDs
+		bool loadTextures = true;		// Texture IDs are set to 0xffffffff when textures are skipped
+		bool loadNormals = true;
+		bool loadTextureCoords = true;
+		bool loadTangents = true;		// Tangents need both normals and texture coordinates
+		bool quantizeVertices = false;	// Store the vertex data in Mesh::quantized instead of floats
+
+		// Build each geometry once in its local space and place it with Scene::instances, instead of baking
+		// every node's transform into its own copy. Nodes only share a mesh when they also share their materials,
+		// since the vertex material IDs index the scene materials.
+		bool instanceGeometry = false;
+
+		// Corners closer than these tolerances are welded into one vertex, by default only identical corners are.
+		// Useful for exported CAD data where the baked transforms leave nearly equal vertices apart.
+		WeldTolerances weldTolerances;
+
+		// Meshes are skipped when this returns true for the name of their node
+		std::function<bool(const std::string& nodeName)> skipMesh;
+
+		// When set, processed scenes are cached in this directory keyed by the file contents and the options.
+		// Loads with a skipMesh predicate are never cached since the predicate cannot be compared.
+		std::string cacheDirectory;
+	};
+
+	/// <summary>
+	/// The version of the loader output, part of the scene cache key. Change it whenever the meshes,
+	/// materials or lights produced from the same file change.
+	/// </summary>
+	const std::uint32_t loaderVersion = 2;
+
+	/// <summary>
+	/// The version of the mesh fingerprints from getMeshFingerprint. Change it whenever the geometry
+	/// contents are hashed in a different form, so stored fingerprints no longer match.
+	/// </summary>
+	const std::uint32_t meshFingerprintVersion = 3;
+
 	/// <summary>
 	/// Loads a given FBX file and creates a set of data that can be used for 
 	/// PBR.
 	/// </summary>
 	/// <param name="filename">The .fbx file path</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>A Scene structure</returns>
+	Scene loadFBXFile(const char* filename, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Loads an FBX file held in memory, for example inside an archive, without copying it.
+	/// The meshes are built straight from the data, which only has to live until the call returns.
+	/// </summary>
+	/// <param name="data">The file contents</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>A Scene structure</returns>
+	Scene loadFBXFile(std::span<const std::byte> data, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Loads an FBX file from the rest of a stream, which does not have to be seekable.
+	/// The stream is read in chunks with readFileData, the file is never written to disk.
+	/// </summary>
+	/// <param name="stream">The stream holding the file, opened in binary mode</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>A Scene structure</returns>
+	Scene loadFBXFile(std::istream& stream, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Loads an FBX file from a read callback (a pipe or a decompressor), read in chunks with readFileData
+	/// </summary>
+	/// <param name="read">Reads the next bytes of the file, returning 0 at the end</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>A Scene structure</returns>
+	Scene loadFBXFile(const ReadCallback& read, const LoadOptions& options = LoadOptions());
+
+	// The temporary buffers used to build a mesh and a thread safe set of them, defined in FBXFileLoader.cpp
+	struct MeshBuffers;
+	class MeshBufferPool;
+
+	/// <summary>
+	/// Loads FBX files one after another with the same options, keeping the temporary buffers used to
+	/// build meshes between files instead of allocating them for every file. Meant for loading many small
+	/// files, the buffers grow to fit the largest mesh loaded. Use one loader per thread.
+	/// </summary>
+	class Loader
+	{
+	public:
+		/// <summary>
+		/// Creates a loader, no buffers are allocated until the first load
+		/// </summary>
+		/// <param name="options">Which parts of the files to load</param>
+		explicit Loader(const LoadOptions& options = LoadOptions());
+		~Loader();
+
+		Loader(const Loader&) = delete;
+		Loader& operator=(const Loader&) = delete;
+
+		/// <summary>
+		/// Loads a given FBX file, the same as loadFBXFile with the loader options
+		/// </summary>
+		/// <param name="filename">The .fbx file path</param>
+		/// <returns>A Scene structure</returns>
+		Scene load(const char* filename);
+
+		/// <summary>
+		/// Loads an FBX file held in memory, the same as loadFBXFile with the loader options
+		/// </summary>
+		/// <param name="data">The file contents</param>
+		/// <returns>A Scene structure</returns>
+		Scene load(std::span<const std::byte> data);
+
+		/// <summary>
+		/// Loads an FBX file from the rest of a stream, the same as loadFBXFile with the loader options
+		/// </summary>
+		/// <param name="stream">The stream holding the file, opened in binary mode</param>
+		/// <returns>A Scene structure</returns>
+		Scene load(std::istream& stream);
+
+		/// <summary>
+		/// Loads an FBX file from a read callback, the same as loadFBXFile with the loader options
+		/// </summary>
+		/// <param name="read">Reads the next bytes of the file, returning 0 at the end</param>
+		/// <returns>A Scene structure</returns>
+		Scene load(const ReadCallback& read);
+
+		const LoadOptions& getOptions() const { return options; }
+		void setOptions(const LoadOptions& newOptions) { options = newOptions; }
+
+		/// <summary>
+		/// Frees the kept buffers, for example after loading an unusually large file
+		/// </summary>
+		void releaseBuffers();
+
+	private:
+		LoadOptions options;
+		std::unique_ptr<MeshBufferPool> buffers;
+	};
+
+	/// <summary>
+	/// Loads a list of FBX files at once on the shared thread pool. Each thread loads whole files one
+	/// after another with its own Loader, so no state is shared between files. Once the threads run out
+	/// of files the idle ones help build the meshes of the files still loading.
+	/// The first exception thrown by a load is rethrown once the running loads have finished, the files
+	/// not started by then are not loaded.
+	/// </summary>
+	/// <param name="filenames">The .fbx file paths</param>
+	/// <param name="threadCount">The number of files loaded at once, 0 or more than the pool size plus the calling thread uses all of them</param>
+	/// <param name="options">Which parts of the files to load</param>
+	/// <returns>The scenes in the order of the file paths</returns>
+	std::vector<Scene> loadFBXFiles(const std::vector<std::string>& filenames, unsigned threadCount = 0, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Loads a given FBX file again after it has changed, only rebuilding the meshes whose geometry,
+	/// transform or materials changed. The other meshes are moved over from the previous scene.
+	/// Each geometry record is read and decompressed once, for both its fingerprint and its rebuild.
+	/// </summary>
+	/// <param name="filename">The .fbx file path</param>
+	/// <param name="previousScene">The scene of the previous load, reused meshes are moved out of it</param>
+	/// <param name="meshFingerprints">The fingerprints of the previous scene meshes (empty to build every mesh), replaced by those of the new scene</param>
+	/// <param name="options">Which parts of the file to load</param>
 	/// <returns>A Scene structure</returns>
-	Scene loadFBXFile(const char* filename);
+	Scene reloadFBXFile(const char* filename, Scene& previousScene, std::vector<std::uint64_t>& meshFingerprints, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Gets the fingerprint of the mesh of a node, from the geometry records the loader reads, its
+	/// transform, its materials, the load options and meshFingerprintVersion. Meshes with equal fingerprints have equal data.
+	/// </summary>
+	/// <param name="graph">The scene graph the node belongs to</param>
+	/// <param name="node">A node with a geometry</param>
+	/// <param name="materialIndices">The material indices from the node</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>The mesh fingerprint</returns>
+	std::uint64_t getMeshFingerprint(const SceneGraph& graph, const SceneNode& node, const std::vector<uint32_t>& materialIndices, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Counts of the parts of a scene that will be loaded, gathered from the file index and array headers
+	/// </summary>
+	struct SceneStats
+	{
+		size_t nodeCount = 0;
+		size_t meshCount = 0;
+		size_t materialCount = 0;
+		size_t lightCount = 0;
+		std::uint64_t controlPointCount = 0;
+		std::uint64_t polygonVertexCount = 0;
+	};
+
+	/// <summary>
+	/// Counts the parts of a scene graph that the given options would load, without reading any geometry
+	/// </summary>
+	/// <param name="graph">The scene graph of the file</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>The scene counts</returns>
+	SceneStats getSceneStats(const SceneGraph& graph, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Reads the index of a given FBX file and counts the parts of it that the given options would load
+	/// </summary>
+	/// <param name="filename">The .fbx file path</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>The scene counts</returns>
+	SceneStats getSceneStats(const char* filename, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// The progress of an asynchronous load, updated by the loading threads
+	/// </summary>
+	struct LoadProgress
+	{
+		std::atomic<std::uint64_t> totalBytes{ 0 };		// The size of the file, known once the index has been read
+		std::atomic<std::uint64_t> bytesParsed{ 0 };
+		std::atomic<std::uint64_t> nodesVisited{ 0 };
+		std::atomic<std::uint64_t> meshCount{ 0 };
+		std::atomic<std::uint64_t> meshesBuilt{ 0 };
+
+		// Set to stop the load, it is checked between meshes
+		std::atomic<bool> cancelled{ false };
+	};
+
+	/// <summary>
+	/// A load running in the background
+	/// </summary>
+	struct AsyncLoad
+	{
+		// Holds the scene once loaded. get() rethrows any error, including a runtime_error when cancelled.
+		std::future<Scene> scene;
+		std::shared_ptr<LoadProgress> progress;
+
+		/// <summary>
+		/// Asks the load to stop, meshes being built are finished and the rest are never read
+		/// </summary>
+		void cancel() { progress->cancelled = true; }
+	};
+
+	/// <summary>
+	/// Starts loading a given FBX file on the shared thread pool and returns straight away
+	/// </summary>
+	/// <param name="filename">The .fbx file path</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>The future scene and the progress of the load</returns>
+	AsyncLoad loadFBXFileAsync(const char* filename, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Receives the parts of a scene while it is being loaded
+	/// </summary>
+	struct LoadCallbacks
+	{
+		// Called for each material before any mesh, the texture IDs index the texture sets of the scene passed in
+		std::function<void(std::uint32_t materialIndex, const Material& material, const Scene& scene)> onMaterial;
+
+		// Called for each light before any mesh
+		std::function<void(const Light& light)> onLight;
+
+		// Called for each mesh instance before any mesh, when geometry is instanced
+		std::function<void(const MeshInstance& instance)> onInstance;
+
+		// Called as each mesh is finished, in any order and possibly from a worker thread (but never two at once).
+		// The mesh may be moved from, the loader drops it afterwards.
+		std::function<void(size_t meshIndex, Mesh& mesh)> onMesh;
+	};
+
+	/// <summary>
+	/// Loads a given FBX file and hands over the materials, lights and meshes as soon as they are ready
+	/// instead of returning the whole scene at the end. The mesh indices match the order of loadFBXFile.
+	/// </summary>
+	/// <param name="filename">The .fbx file path</param>
+	/// <param name="callbacks">The functions receiving the scene data</param>
+	/// <param name="options">Which parts of the file to load</param>
+	void streamFBXFile(const char* filename, const LoadCallbacks& callbacks, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// The mesh slots of the geometry and material lists placed so far, so nodes that place the same
+	/// geometry with the same materials can share a slot when geometry is instanced
+	/// </summary>
+	class GeometryInstances
+	{
+	public:
+		/// <summary>
+		/// Finds the mesh slot of a node and adds its placement to the scene instances when geometry is instanced
+		/// </summary>
+		/// <param name="node">A node with a mesh</param>
+		/// <param name="materialIndices">The indices of the node materials in the output scene</param>
+		/// <param name="slotCount">The number of mesh slots so far</param>
+		/// <param name="outputScene">The scene the instance is added to</param>
+		/// <param name="options">Which parts of the file to load</param>
+		/// <returns>The slot of an earlier node with the same geometry and materials, or slotCount when the caller must add a slot</returns>
+		size_t findMeshSlot(const SceneNode& node, const std::vector<uint32_t>& materialIndices, size_t slotCount, Scene& outputScene, const LoadOptions& options);
+
+	private:
+		struct Key
+		{
+			const Node* geometry;
+			std::vector<uint32_t> materials;
+
+			bool operator==(const Key& other) const = default;
+		};
+
+		struct KeyHash
+		{
+			size_t operator()(const Key& key) const;
+		};
+
+		std::unordered_map<Key, size_t, KeyHash> slots;
+	};
+
+	/// <summary>
+	/// Gets the children of a given node. The materials and lights are created straight away,
+	/// each mesh gets an empty slot in the output scene and its node is added to meshNodes.
+	/// When geometry is instanced, nodes reusing the geometry and materials of an earlier slot
+	/// only add an instance of it.
+	/// </summary>
+	/// <param name="node">A node in the scene graph</param>
+	/// <param name="graph">The scene graph the node belongs to</param>
+	/// <param name="outputScene">The output data for the program</param>
+	/// <param name="meshNodes">The nodes of the mesh slots, in the same order</param>
+	/// <param name="options">Which parts of the file to load</param>
+	void getChildren(const SceneNode& node, const SceneGraph& graph, Scene& outputScene, std::vector<const SceneNode*>& meshNodes, const LoadOptions& options = LoadOptions());
 
 	/// <summary>
-	/// Gets the children of a given node
+	/// Gets the transform baked into the vertices of a node's mesh
 	/// </summary>
-	/// <param name="node">A node in an FbxScene</param>
-	void getChildren(FbxNode* node, Scene& outputScene);
+	/// <param name="node">A node with a mesh</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>The global transform of the node, or the identity when geometry is instanced</returns>
+	glm::mat4 getMeshTransform(const SceneNode& node, const LoadOptions& options);
+
+	/// <summary>
+	/// Gets the materials of a node, creating the ones not yet in the output scene
+	/// </summary>
+	/// <param name="node">A node in the scene graph</param>
+	/// <param name="graph">The scene graph the node belongs to</param>
+	/// <param name="outputScene">The output data for the program</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>The indices of the node materials in the output scene</returns>
+	std::vector<uint32_t> getNodeMaterials(const SceneNode& node, const SceneGraph& graph, Scene& outputScene, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// The triangles of a polygon mesh
+	/// </summary>
+	struct Triangulation
+	{
+		// The polygon vertex used by each triangle corner
+		std::vector<std::uint32_t> polygonVertices;
+
+		// The source polygon of each triangle
+		std::vector<std::uint32_t> trianglePolygons;
+	};
+
+	/// <summary>
+	/// Splits the polygons of a mesh into triangles. Convex polygons are fanned out and
+	/// concave ones are ear clipped, meshes of triangles only are passed straight through.
+	/// </summary>
+	/// <param name="polygonVertexIndices">The PolygonVertexIndex array of the mesh</param>
+	/// <param name="controlPoints">The Vertices array of the mesh</param>
+	/// <returns>The triangles referencing the polygon vertices</returns>
+	Triangulation triangulateMesh(const ArrayView<std::int32_t>& polygonVertexIndices, const ArrayView<double>& controlPoints);
+
+	/// <summary>
+	/// Splits the polygons of a mesh into triangles, reusing the memory of the output
+	/// </summary>
+	/// <param name="polygonVertexIndices">The PolygonVertexIndex array of the mesh</param>
+	/// <param name="controlPoints">The Vertices array of the mesh</param>
+	/// <param name="outTriangulation">Replaced by the triangles referencing the polygon vertices</param>
+	void triangulateMesh(const ArrayView<std::int32_t>& polygonVertexIndices, const ArrayView<double>& controlPoints, Triangulation& outTriangulation);
 
 	/// <summary>
 	/// Creates and populates a mesh data structure given an Fbx mesh
 	/// </summary>
-	/// <param name="inMesh">An FbxMesh</param>
+	/// <param name="inMesh">A Geometry record of class Mesh</param>
+	/// <param name="materialIndices">The material indices from the node</param>
+	/// <param name="transform">The node transform matrix</param>
+	/// <param name="options">Which parts of the mesh to load</param>
+	/// <returns>A mesh data structure</returns>
+	Mesh createMeshData(const Node& inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Creates and populates a mesh data structure given an Fbx mesh, using the given temporary buffers
+	/// </summary>
+	/// <param name="inMesh">A Geometry record of class Mesh</param>
+	/// <param name="materialIndices">The material indices from the node</param>
+	/// <param name="transform">The node transform matrix</param>
+	/// <param name="options">Which parts of the mesh to load</param>
+	/// <param name="buffers">The temporary buffers, reused between meshes</param>
+	/// <returns>A mesh data structure</returns>
+	Mesh createMeshData(const Node& inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform, const LoadOptions& options, MeshBuffers& buffers);
+
+	/// <summary>
+	/// Reads the geometry record of a mesh if it was deferred (leaving out the layers that are
+	/// not needed) and creates the mesh data from it
+	/// </summary>
+	/// <param name="graph">The scene graph the geometry belongs to</param>
+	/// <param name="inMesh">A Geometry record of class Mesh</param>
+	/// <param name="materialIndices">The material indices from the node</param>
+	/// <param name="transform">The node transform matrix</param>
+	/// <param name="options">Which parts of the mesh to load</param>
+	/// <returns>A mesh data structure</returns>
+	Mesh readMeshData(const SceneGraph& graph, const Node& inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform, const LoadOptions& options = LoadOptions());
+
+	/// <summary>
+	/// Reads the geometry record of a mesh if it was deferred and creates the mesh data from it, using the given temporary buffers
+	/// </summary>
+	/// <param name="graph">The scene graph the geometry belongs to</param>
+	/// <param name="inMesh">A Geometry record of class Mesh</param>
 	/// <param name="materialIndices">The material indices from the node</param>
 	/// <param name="transform">The node transform matrix</param>
+	/// <param name="options">Which parts of the mesh to load</param>
+	/// <param name="buffers">The temporary buffers, reused between meshes</param>
 	/// <returns>A mesh data structure</returns>
-	Mesh createMeshData(FbxMesh* inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform);
+	Mesh readMeshData(const SceneGraph& graph, const Node& inMesh, std::vector<uint32_t>& materialIndices, glm::mat4 transform, const LoadOptions& options, MeshBuffers& buffers);
 
 	/// <summary>
 	/// Creates and populates a material data structure given an Fbx material
 	/// </summary>
-	/// <param name="inMaterial">Fbx Material</param>
+	/// <param name="inMaterial">A Material record</param>
+	/// <param name="graph">The scene graph the material belongs to</param>
 	/// <param name="outputScene">The output data for the program</param>
+	/// <param name="options">Which parts of the material to load</param>
 	/// <returns>Material data structure</returns>
-	Material createMaterialData(FbxSurfaceMaterial* inMaterial, Scene& outputScene);
+	Material createMaterialData(const Node& inMaterial, const SceneGraph& graph, Scene& outputScene, const LoadOptions& options = LoadOptions());
 
 	/// <summary>
 	/// Creates a texture and adds it to the output scene if it does not already exist
 	/// </summary>
-	/// <param name="texture">The texture to look for / add</param>
+	/// <param name="texture">The Texture record to look for / add</param>
 	/// <param name="textureSet">The output texture set to use</param>
 	/// <returns>The ID of the texture in the output scene</returns>
-	std::uint32_t createTexture(FbxFileTexture* texture, std::vector<Texture>& textureSet);
+	std::uint32_t createTexture(const Node& texture, std::vector<Texture>& textureSet);
 
 	/// <summary>
 	/// Creates and populates a light data structure given an fbx light
 	/// </summary>
-	/// <param name="inLight">Fbx light</param>
+	/// <param name="inLight">A NodeAttribute record of class Light</param>
+	/// <param name="graph">The scene graph the light belongs to</param>
 	/// <param name="transform">The node transform matrix</param>
 	/// <returns></returns>
-	Light createLightData(FbxLight* inLight, glm::mat4 transform);
+	Light createLightData(const Node& inLight, const SceneGraph& graph, glm::mat4 transform);
+
+	/// <summary>
+	/// Quantizes the vertex data of a mesh into Mesh::quantized and frees the float vertex data.
+	/// Cuts the vertex size from 52 bytes to at most 20.
+	/// </summary>
+	/// <param name="mesh">A mesh with float vertex data</param>
+	void quantizeMesh(Mesh& mesh);
+
+	/// <summary>
+	/// Restores the float vertex data of a quantized mesh and frees the quantized data
+	/// </summary>
+	/// <param name="mesh">A mesh with quantized vertex data</param>
+	void dequantizeMesh(Mesh& mesh);
 
 	/// <summary>
 	/// Calculates the vertex tangents for a given mesh
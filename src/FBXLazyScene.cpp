@@ -0,0 +1,65 @@
+#include "FBXLazyScene.hpp"
+
+namespace fbx {
+
+    LazyScene::LazyScene(const char* filename, const LoadOptions& options)
+        : options(options), graph(buildSceneGraph(readDocument(filename, true))) {
+
+        // Build the materials, lights and mesh index from the node hierarchy
+        indexChildren(graph.nodes[0]);
+
+        // Leave a slot for each mesh so they can be decoded in any order
+        scene.meshes.resize(meshRecords.size());
+        meshOnce = std::make_unique<std::once_flag[]>(meshRecords.size());
+        meshLoaded = std::make_unique<std::atomic<bool>[]>(meshRecords.size());
+        for (size_t i = 0; i < meshRecords.size(); i++) {
+            meshLoaded[i] = false;
+        }
+    }
+
+    const Mesh& LazyScene::getMesh(size_t meshIndex) {
+        const MeshRecord& record = meshRecords.at(meshIndex);
+
+        std::call_once(meshOnce[meshIndex], [&]() {
+            std::vector<uint32_t> materialIndices = record.materials;
+
+            // Read the geometry record now, its arrays point into the mapped file and are dropped once the mesh is built
+            scene.meshes[meshIndex] = readMeshData(graph, *record.geometry, materialIndices, record.transform, options);
+            scene.meshes[meshIndex].materials = record.materials;
+
+            meshLoaded[meshIndex] = true;
+        });
+
+        return scene.meshes[meshIndex];
+    }
+
+    void LazyScene::indexChildren(const SceneNode& node) {
+        // Materials are created in the same order as loadFBXFile so the indices match
+        std::vector<uint32_t> materialIndices = getNodeMaterials(node, graph, scene, options);
+
+        if (node.geometry == nullptr) {
+            if (node.light != nullptr && options.loadLights) {
+                scene.lights.emplace_back(createLightData(*node.light, graph, node.globalTransform));
+            }
+        }
+        else if (!options.skipMesh || !options.skipMesh(node.name)) {
+            // Instanced geometry is indexed once for each set of materials, like getChildren
+            size_t meshIndex = instances.findMeshSlot(node, materialIndices, meshRecords.size(), scene, options);
+
+            if (meshIndex == meshRecords.size()) {
+                MeshRecord record;
+                record.name = node.name;
+                record.transform = getMeshTransform(node, options);
+                record.materials = materialIndices;
+                record.byteOffset = node.geometry->recordOffset;
+                record.byteSize = node.geometry->recordSize;
+                record.geometry = node.geometry;
+                meshRecords.emplace_back(std::move(record));
+            }
+        }
+
+        for (size_t child : node.children) {
+            indexChildren(graph.nodes[child]);
+        }
+    }
+}
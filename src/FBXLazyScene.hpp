@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FBXFileLoader.hpp"
+
+namespace fbx {
+	/// <summary>
+	/// The index entry of a mesh in a lazily loaded scene
+	/// </summary>
+	struct MeshRecord
+	{
+		std::string name;						// The name of the node using the mesh
+		glm::mat4 transform;					// The transform baked into the mesh, see getMeshTransform
+		std::vector<uint32_t> materials;		// Indices of the node materials in the scene
+
+		// The byte range of the Geometry record in the file (0 when it was not deferred, e.g. ASCII files)
+		std::uint64_t byteOffset = 0;
+		std::uint64_t byteSize = 0;
+
+		const Node* geometry = nullptr;
+	};
+
+	/// <summary>
+	/// A scene whose meshes are only decoded when they are first accessed.
+	/// Opening the scene reads the file index (node hierarchy, transforms, materials,
+	/// textures and lights) while skipping over the geometry records.
+	/// </summary>
+	class LazyScene
+	{
+	public:
+		/// <summary>
+		/// Opens an FBX file and indexes its meshes
+		/// </summary>
+		/// <param name="filename">The .fbx file path</param>
+		/// <param name="options">Which parts of the file to load</param>
+		explicit LazyScene(const char* filename, const LoadOptions& options = LoadOptions());
+
+		/// <summary>
+		/// Gets the number of meshes in the scene
+		/// </summary>
+		size_t getMeshCount() const { return meshRecords.size(); }
+
+		/// <summary>
+		/// Gets the index entry of a mesh without decoding it
+		/// </summary>
+		/// <param name="meshIndex">The index of the mesh</param>
+		const MeshRecord& getMeshRecord(size_t meshIndex) const { return meshRecords.at(meshIndex); }
+
+		/// <summary>
+		/// Checks if a mesh has been decoded
+		/// </summary>
+		/// <param name="meshIndex">The index of the mesh</param>
+		bool isMeshLoaded(size_t meshIndex) const { return meshLoaded[meshIndex].load(); }
+
+		/// <summary>
+		/// Gets a mesh, decoding it on first access.
+		/// Different meshes can be requested from multiple threads at once.
+		/// </summary>
+		/// <param name="meshIndex">The index of the mesh</param>
+		/// <returns>The mesh data</returns>
+		const Mesh& getMesh(size_t meshIndex);
+
+		/// <summary>
+		/// Gets the scene data. The materials, textures and lights are always loaded,
+		/// meshes which have not been accessed yet are empty.
+		/// </summary>
+		const Scene& getScene() const { return scene; }
+
+	private:
+		void indexChildren(const SceneNode& node);
+
+		LoadOptions options;
+		SceneGraph graph;
+		Scene scene;
+		std::vector<MeshRecord> meshRecords;
+		GeometryInstances instances;
+		std::unique_ptr<std::once_flag[]> meshOnce;
+		std::unique_ptr<std::atomic<bool>[]> meshLoaded;
+	};
+}
@@ -0,0 +1,561 @@
+#include "FBXMeshCodec.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <zlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FBX_CODEC_SSE2 1
+#endif
+
+namespace fbx {
+
+    namespace {
+        const char meshMagic[4] = { 'F', 'B', 'X', 'M' };
+
+        // Header flags, the attribute flags mark which optional vertex streams are stored
+        enum EncodedFlags : std::uint32_t {
+            Deflated = 1 << 0,
+            HasTextureCoords = 1 << 1,
+            HasNormals = 1 << 2,
+            HasTangents = 1 << 3,
+            HasMaterialIDs = 1 << 4,
+        };
+
+        struct EncodedHeader
+        {
+            char magic[4];
+            std::uint32_t version;
+            std::uint32_t flags;
+            std::uint32_t vertexCount;
+            std::uint32_t indexCount;
+            std::uint32_t materialCount;
+            std::uint64_t payloadSize;		// The size of the coded streams before deflating
+        };
+        static_assert(sizeof(EncodedHeader) == 32, "Unexpected encoded mesh header layout.");
+
+        // Deflate cannot expand data by more than about 1032 to 1, so larger payload sizes are corrupt
+        const std::uint64_t maxDeflateRatio = 1032;
+
+        inline std::uint32_t zigzagEncode(std::uint32_t value) {
+            return (value << 1) ^ (std::uint32_t)((std::int32_t)value >> 31);
+        }
+
+        inline std::uint32_t zigzagDecode(std::uint32_t value) {
+            return (value >> 1) ^ (0u - (value & 1));
+        }
+
+        /// <summary>
+        /// Reorders the triangles of a triangle list so the vertices they use are mostly still in a small post
+        /// transform cache (Tipsify, Sander et al. 2007). Each step emits the remaining triangles around a fan
+        /// vertex and moves to the vertex used by those triangles that will stay in the cache the longest.
+        /// The triangles keep their winding and the work is linear in the number of indices.
+        /// </summary>
+        std::vector<std::uint32_t> optimizeVertexCache(const std::vector<std::uint32_t>& indices, size_t vertexCount) {
+            const size_t cacheSize = 16;
+            size_t triangleCount = indices.size() / 3;
+            std::vector<std::uint32_t> output;
+            output.reserve(indices.size());
+            if (triangleCount == 0) {
+                return output;
+            }
+
+            // The triangles using each vertex, and how many of them are still to be emitted
+            std::vector<std::uint32_t> liveTriangles(vertexCount, 0);
+            for (std::uint32_t index : indices) {
+                liveTriangles[index]++;
+            }
+            std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+            for (size_t v = 0; v < vertexCount; v++) {
+                adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+            }
+            std::vector<std::uint32_t> adjacency(indices.size());
+            std::vector<size_t> adjacencyEnd(adjacencyStart.begin(), adjacencyStart.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++) {
+                adjacency[adjacencyEnd[indices[i]]++] = (std::uint32_t)(i / 3);
+            }
+
+            // A vertex is in the cache while fewer than cacheSize misses happened since it was loaded
+            std::vector<size_t> cacheTime(vertexCount, 0);
+            std::vector<bool> emitted(triangleCount, false);
+            std::vector<std::uint32_t> deadEnds;
+            std::vector<std::uint32_t> candidates;
+            size_t time = cacheSize + 1;
+            size_t nextVertex = 0;
+
+            size_t fanVertex = indices[0];
+            while (fanVertex < vertexCount) {
+                candidates.clear();
+                for (size_t a = adjacencyStart[fanVertex]; a < adjacencyStart[fanVertex + 1]; a++) {
+                    std::uint32_t triangle = adjacency[a];
+                    if (emitted[triangle]) {
+                        continue;
+                    }
+                    emitted[triangle] = true;
+                    for (size_t corner = 0; corner < 3; corner++) {
+                        std::uint32_t vertex = indices[triangle * 3 + corner];
+                        output.emplace_back(vertex);
+                        deadEnds.emplace_back(vertex);
+                        candidates.emplace_back(vertex);
+                        liveTriangles[vertex]--;
+                        if (time - cacheTime[vertex] > cacheSize) {
+                            cacheTime[vertex] = time++;
+                        }
+                    }
+                }
+
+                // Prefer the candidate loaded longest ago that is still cached after fanning its remaining triangles
+                fanVertex = vertexCount;
+                size_t bestPriority = 0;
+                for (std::uint32_t vertex : candidates) {
+                    if (liveTriangles[vertex] == 0) {
+                        continue;
+                    }
+                    size_t priority = 1;
+                    if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize) {
+                        priority += time - cacheTime[vertex];
+                    }
+                    if (priority > bestPriority) {
+                        bestPriority = priority;
+                        fanVertex = vertex;
+                    }
+                }
+
+                // At a dead end go back to a recently used vertex, then to the next vertex in input order
+                while (fanVertex == vertexCount && !deadEnds.empty()) {
+                    std::uint32_t vertex = deadEnds.back();
+                    deadEnds.pop_back();
+                    if (liveTriangles[vertex] > 0) {
+                        fanVertex = vertex;
+                    }
+                }
+                while (fanVertex == vertexCount && nextVertex < vertexCount) {
+                    if (liveTriangles[nextVertex] > 0) {
+                        fanVertex = nextVertex;
+                    }
+                    nextVertex++;
+                }
+            }
+            return output;
+        }
+
+        /// <summary>
+        /// Appends a stream of values as the byte planes of their zigzag coded deltas.
+        /// A mask byte in front marks the planes that are stored, the others are all zero.
+        /// A stream that is not empty always stores its low plane, so every value takes at least a byte
+        /// and decoders can check the counts against the data size before allocating.
+        /// </summary>
+        void encodeStream(const std::vector<std::uint32_t>& values, std::vector<char>& output) {
+            size_t count = values.size();
+            std::vector<std::uint32_t> deltas(count);
+            std::uint32_t previous = 0;
+            std::uint32_t usedBits = 0;
+            for (size_t i = 0; i < count; i++) {
+                deltas[i] = zigzagEncode(values[i] - previous);
+                previous = values[i];
+                usedBits |= deltas[i];
+            }
+
+            std::uint8_t planeMask = count > 0 ? 1 : 0;
+            for (int plane = 0; plane < 4; plane++) {
+                if ((usedBits >> (plane * 8)) & 0xff) {
+                    planeMask |= 1 << plane;
+                }
+            }
+            output.push_back((char)planeMask);
+
+            for (int plane = 0; plane < 4; plane++) {
+                if ((planeMask & (1 << plane)) == 0) {
+                    continue;
+                }
+                size_t start = output.size();
+                output.resize(start + count);
+                for (size_t i = 0; i < count; i++) {
+                    output[start + i] = (char)(deltas[i] >> (plane * 8));
+                }
+            }
+        }
+
+        /// <summary>
+        /// The byte planes of a stream written by encodeStream, nullptr for the planes that are all zero
+        /// </summary>
+        struct StreamPlanes
+        {
+            const std::uint8_t* planes[4] = {};
+        };
+
+        /// <summary>
+        /// Finds the planes of the next stream in the payload and moves the cursor past them
+        /// </summary>
+        StreamPlanes readStreamPlanes(const std::uint8_t*& cursor, const std::uint8_t* end, size_t count) {
+            if (cursor >= end) {
+                throw std::runtime_error("Unexpected end of encoded mesh.");
+            }
+            std::uint8_t planeMask = *cursor++;
+            if (count > 0 && (planeMask & 1) == 0) {
+                throw std::runtime_error("Invalid encoded mesh stream.");
+            }
+
+            StreamPlanes stream;
+            for (int plane = 0; plane < 4; plane++) {
+                if (planeMask & (1 << plane)) {
+                    if ((size_t)(end - cursor) < count) {
+                        throw std::runtime_error("Unexpected end of encoded mesh.");
+                    }
+                    stream.planes[plane] = cursor;
+                    cursor += count;
+                }
+            }
+            return stream;
+        }
+
+        /// <summary>
+        /// Decodes the value at index i of a stream from the value before it
+        /// </summary>
+        inline std::uint32_t decodeValue(const StreamPlanes& stream, size_t i, std::uint32_t previous) {
+            std::uint32_t value = 0;
+            for (int plane = 0; plane < 4; plane++) {
+                if (stream.planes[plane]) {
+                    value |= (std::uint32_t)stream.planes[plane][i] << (plane * 8);
+                }
+            }
+            return previous + zigzagDecode(value);
+        }
+
+#ifdef FBX_CODEC_SSE2
+        /// <summary>
+        /// Decodes the 16 values of a stream from index i into 4 registers. The carry holds the
+        /// last decoded value in every lane and is updated for the next block.
+        /// </summary>
+        inline void decodeBlock(const StreamPlanes& stream, size_t i, __m128i& carry, __m128i values[4]) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i one = _mm_set1_epi32(1);
+            auto loadPlane = [&](int plane) {
+                return stream.planes[plane] ? _mm_loadu_si128((const __m128i*)(stream.planes[plane] + i)) : zero;
+            };
+
+            // Interleave the planes back into 32 bit values
+            __m128i b0 = loadPlane(0), b1 = loadPlane(1), b2 = loadPlane(2), b3 = loadPlane(3);
+            __m128i low01 = _mm_unpacklo_epi8(b0, b1), high01 = _mm_unpackhi_epi8(b0, b1);
+            __m128i low23 = _mm_unpacklo_epi8(b2, b3), high23 = _mm_unpackhi_epi8(b2, b3);
+            values[0] = _mm_unpacklo_epi16(low01, low23);
+            values[1] = _mm_unpackhi_epi16(low01, low23);
+            values[2] = _mm_unpacklo_epi16(high01, high23);
+            values[3] = _mm_unpackhi_epi16(high01, high23);
+
+            for (int r = 0; r < 4; r++) {
+                // Undo the zigzag coding then add up the deltas (a prefix sum across the lanes)
+                __m128i value = values[r];
+                __m128i delta = _mm_xor_si128(_mm_srli_epi32(value, 1), _mm_sub_epi32(zero, _mm_and_si128(value, one)));
+                delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 4));
+                delta = _mm_add_epi32(delta, _mm_slli_si128(delta, 8));
+                values[r] = _mm_add_epi32(delta, carry);
+                carry = _mm_shuffle_epi32(values[r], 0xff);
+            }
+        }
+
+        /// <summary>
+        /// Stores 4 vertices of an attribute from one register per component, interleaving the components
+        /// </summary>
+        template<int Components>
+        inline void storeVertices(const __m128i* components, std::uint32_t* output) {
+            if constexpr (Components == 1) {
+                _mm_storeu_si128((__m128i*)output, components[0]);
+            }
+            else if constexpr (Components == 2) {
+                _mm_storeu_si128((__m128i*)output, _mm_unpacklo_epi32(components[0], components[1]));
+                _mm_storeu_si128((__m128i*)(output + 4), _mm_unpackhi_epi32(components[0], components[1]));
+            }
+            else if constexpr (Components == 3) {
+                // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+                __m128 x = _mm_castsi128_ps(components[0]);
+                __m128 y = _mm_castsi128_ps(components[1]);
+                __m128 z = _mm_castsi128_ps(components[2]);
+                __m128 xyLow = _mm_unpacklo_ps(x, y);
+                __m128 xyHigh = _mm_unpackhi_ps(x, y);
+                __m128 first = _mm_shuffle_ps(xyLow, _mm_shuffle_ps(z, xyLow, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0));
+                __m128 second = _mm_shuffle_ps(_mm_shuffle_ps(xyLow, z, _MM_SHUFFLE(1, 1, 3, 3)), xyHigh, _MM_SHUFFLE(1, 0, 2, 0));
+                __m128 third = _mm_shuffle_ps(z, xyHigh, _MM_SHUFFLE(3, 2, 3, 2));
+                third = _mm_shuffle_ps(third, third, _MM_SHUFFLE(1, 3, 2, 0));
+                _mm_storeu_ps((float*)output, first);
+                _mm_storeu_ps((float*)(output + 4), second);
+                _mm_storeu_ps((float*)(output + 8), third);
+            }
+            else {
+                static_assert(Components == 4, "Unsupported attribute size.");
+                __m128i xy01 = _mm_unpacklo_epi32(components[0], components[1]);
+                __m128i xy23 = _mm_unpackhi_epi32(components[0], components[1]);
+                __m128i zw01 = _mm_unpacklo_epi32(components[2], components[3]);
+                __m128i zw23 = _mm_unpackhi_epi32(components[2], components[3]);
+                _mm_storeu_si128((__m128i*)output, _mm_unpacklo_epi64(xy01, zw01));
+                _mm_storeu_si128((__m128i*)(output + 4), _mm_unpackhi_epi64(xy01, zw01));
+                _mm_storeu_si128((__m128i*)(output + 8), _mm_unpacklo_epi64(xy23, zw23));
+                _mm_storeu_si128((__m128i*)(output + 12), _mm_unpackhi_epi64(xy23, zw23));
+            }
+        }
+#endif
+
+        /// <summary>
+        /// Reads a stream written by encodeStream, 16 values at a time when SSE2 is available
+        /// </summary>
+        void decodeStream(const std::uint8_t*& cursor, const std::uint8_t* end, size_t count, std::uint32_t* output) {
+            StreamPlanes stream = readStreamPlanes(cursor, end, count);
+
+            size_t i = 0;
+#ifdef FBX_CODEC_SSE2
+            __m128i carry = _mm_setzero_si128();
+            for (; i + 16 <= count; i += 16) {
+                __m128i values[4];
+                decodeBlock(stream, i, carry, values);
+                for (int r = 0; r < 4; r++) {
+                    _mm_storeu_si128((__m128i*)(output + i + r * 4), values[r]);
+                }
+            }
+#endif
+
+            // Scalar decoding for the tail (or the whole stream without SSE2)
+            std::uint32_t previous = i > 0 ? output[i - 1] : 0;
+            for (; i < count; i++) {
+                previous = decodeValue(stream, i, previous);
+                output[i] = previous;
+            }
+        }
+
+        /// <summary>
+        /// Appends the components of a vertex attribute, one stream per component in the new vertex order.
+        /// Float components are differenced as raw bit patterns.
+        /// </summary>
+        template<typename T>
+        void encodeAttribute(const std::vector<T>& attribute, const std::vector<std::uint32_t>& order, std::vector<char>& output) {
+            const int components = sizeof(T) / sizeof(std::uint32_t);
+            std::vector<std::uint32_t> values(order.size());
+            for (int component = 0; component < components; component++) {
+                for (size_t i = 0; i < order.size(); i++) {
+                    std::memcpy(&values[i], (const char*)&attribute[order[i]] + component * sizeof(std::uint32_t), sizeof(std::uint32_t));
+                }
+                encodeStream(values, output);
+            }
+        }
+
+        /// <summary>
+        /// Reads the component streams of a vertex attribute, decoding them side by side and interleaving
+        /// the components into the vertices, 16 vertices at a time when SSE2 is available
+        /// </summary>
+        template<typename T>
+        void decodeAttribute(const std::uint8_t*& cursor, const std::uint8_t* end, size_t count, std::vector<T>& attribute) {
+            constexpr int components = sizeof(T) / sizeof(std::uint32_t);
+            StreamPlanes streams[components];
+            for (int component = 0; component < components; component++) {
+                streams[component] = readStreamPlanes(cursor, end, count);
+            }
+
+            attribute.resize(count);
+            char* output = (char*)attribute.data();
+            size_t i = 0;
+#ifdef FBX_CODEC_SSE2
+            __m128i carry[components];
+            for (int component = 0; component < components; component++) {
+                carry[component] = _mm_setzero_si128();
+            }
+            for (; i + 16 <= count; i += 16) {
+                __m128i values[components][4];
+                for (int component = 0; component < components; component++) {
+                    decodeBlock(streams[component], i, carry[component], values[component]);
+                }
+                for (int r = 0; r < 4; r++) {
+                    __m128i group[components];
+                    for (int component = 0; component < components; component++) {
+                        group[component] = values[component][r];
+                    }
+                    storeVertices<components>(group, (std::uint32_t*)(output + (i + r * 4) * sizeof(T)));
+                }
+            }
+#endif
+
+            // Scalar decoding for the tail (or the whole attribute without SSE2)
+            std::uint32_t previous[components] = {};
+            if (i > 0) {
+                std::memcpy(previous, output + (i - 1) * sizeof(T), sizeof(T));
+            }
+            for (; i < count; i++) {
+                for (int component = 0; component < components; component++) {
+                    previous[component] = decodeValue(streams[component], i, previous[component]);
+                }
+                std::memcpy(output + i * sizeof(T), previous, sizeof(T));
+            }
+        }
+    }
+
+    std::vector<char> encodeMesh(const Mesh& mesh, bool entropyCoding) {
+        if (!mesh.quantized.vertexPositions.empty()) {
+            throw std::runtime_error("Quantized meshes cannot be encoded, dequantize them first.");
+        }
+        size_t vertexCount = mesh.vertexPositions.size();
+
+        EncodedHeader header{};
+        std::memcpy(header.magic, meshMagic, sizeof(meshMagic));
+        header.version = meshCodecVersion;
+        header.vertexCount = (std::uint32_t)vertexCount;
+        header.indexCount = (std::uint32_t)mesh.vertexIndices.size();
+        header.materialCount = (std::uint32_t)mesh.materials.size();
+
+        // Optional attributes must have a value for every vertex
+        auto checkAttribute = [&](size_t size, std::uint32_t flag) {
+            if (size == 0) {
+                return;
+            }
+            if (size != vertexCount) {
+                throw std::runtime_error("Mesh attribute does not match the vertex count.");
+            }
+            header.flags |= flag;
+        };
+        checkAttribute(mesh.vertexTextureCoords.size(), HasTextureCoords);
+        checkAttribute(mesh.vertexNormals.size(), HasNormals);
+        checkAttribute(mesh.vertexTangents.size(), HasTangents);
+        checkAttribute(mesh.vertexMaterialIDs.size(), HasMaterialIDs);
+
+        for (std::uint32_t index : mesh.vertexIndices) {
+            if (index >= vertexCount) {
+                throw std::runtime_error("Mesh index is out of range.");
+            }
+        }
+
+        // Reorder the triangles for the vertex cache, anything other than a triangle list keeps its order
+        std::vector<std::uint32_t> triangles = mesh.vertexIndices.size() % 3 == 0
+            ? optimizeVertexCache(mesh.vertexIndices, vertexCount) : mesh.vertexIndices;
+
+        // Order the vertices by first use so the index deltas stay small, unused vertices go last
+        std::vector<std::uint32_t> order;
+        std::vector<std::uint32_t> newIndices(vertexCount, 0xffffffff);
+        std::vector<std::uint32_t> indices(triangles.size());
+        order.reserve(vertexCount);
+        for (size_t i = 0; i < triangles.size(); i++) {
+            std::uint32_t index = triangles[i];
+            if (newIndices[index] == 0xffffffff) {
+                newIndices[index] = (std::uint32_t)order.size();
+                order.emplace_back(index);
+            }
+            indices[i] = newIndices[index];
+        }
+        for (std::uint32_t i = 0; i < vertexCount; i++) {
+            if (newIndices[i] == 0xffffffff) {
+                order.emplace_back(i);
+            }
+        }
+
+        std::vector<char> payload;
+        payload.insert(payload.end(), (const char*)mesh.materials.data(), (const char*)(mesh.materials.data() + mesh.materials.size()));
+        encodeAttribute(mesh.vertexPositions, order, payload);
+        if (header.flags & HasTextureCoords)
+            encodeAttribute(mesh.vertexTextureCoords, order, payload);
+        if (header.flags & HasNormals)
+            encodeAttribute(mesh.vertexNormals, order, payload);
+        if (header.flags & HasTangents)
+            encodeAttribute(mesh.vertexTangents, order, payload);
+        if (header.flags & HasMaterialIDs)
+            encodeAttribute(mesh.vertexMaterialIDs, order, payload);
+        encodeStream(indices, payload);
+        header.payloadSize = payload.size();
+
+        std::vector<char> output(sizeof(header));
+        if (entropyCoding) {
+            header.flags |= Deflated;
+            uLongf deflatedSize = compressBound((uLong)payload.size());
+            output.resize(sizeof(header) + deflatedSize);
+            if (compress2((Bytef*)output.data() + sizeof(header), &deflatedSize, (const Bytef*)payload.data(), (uLong)payload.size(), Z_DEFAULT_COMPRESSION) != Z_OK) {
+                throw std::runtime_error("Failed to compress the encoded mesh.");
+            }
+            output.resize(sizeof(header) + deflatedSize);
+        }
+        else {
+            output.resize(sizeof(header) + payload.size());
+            std::memcpy(output.data() + sizeof(header), payload.data(), payload.size());
+        }
+        std::memcpy(output.data(), &header, sizeof(header));
+
+        return output;
+    }
+
+    Mesh decodeMesh(const char* data, size_t size) {
+        EncodedHeader header;
+        if (size < sizeof(header)) {
+            throw std::runtime_error("Data is not an encoded mesh.");
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, meshMagic, sizeof(meshMagic)) != 0) {
+            throw std::runtime_error("Data is not an encoded mesh.");
+        }
+        if (header.version != meshCodecVersion) {
+            throw std::runtime_error("Unsupported encoded mesh version.");
+        }
+
+        // Inflate the streams first if they went through the entropy stage
+        std::vector<char> inflated;
+        const char* payload = data + sizeof(header);
+        size_t payloadSize = size - sizeof(header);
+        if (header.flags & Deflated) {
+            if (header.payloadSize > (std::uint64_t)payloadSize * maxDeflateRatio) {
+                throw std::runtime_error("Invalid encoded mesh size.");
+            }
+            inflated.resize((size_t)header.payloadSize);
+            uLongf inflatedSize = (uLongf)inflated.size();
+            if (uncompress((Bytef*)inflated.data(), &inflatedSize, (const Bytef*)payload, (uLong)payloadSize) != Z_OK || inflatedSize != inflated.size()) {
+                throw std::runtime_error("Failed to decompress the encoded mesh.");
+            }
+            payload = inflated.data();
+            payloadSize = inflated.size();
+        }
+
+        const std::uint8_t* cursor = (const std::uint8_t*)payload;
+        const std::uint8_t* end = cursor + payloadSize;
+
+        // Every value takes at least a byte, so reject counts the payload cannot hold before allocating anything
+        std::uint64_t components = 3;
+        if (header.flags & HasTextureCoords)
+            components += 2;
+        if (header.flags & HasNormals)
+            components += 3;
+        if (header.flags & HasTangents)
+            components += 4;
+        if (header.flags & HasMaterialIDs)
+            components += 1;
+        std::uint64_t minimumSize = (std::uint64_t)header.materialCount * sizeof(std::uint32_t)
+            + (std::uint64_t)header.vertexCount * components + header.indexCount;
+        if (minimumSize > payloadSize) {
+            throw std::runtime_error("Unexpected end of encoded mesh.");
+        }
+
+        Mesh mesh;
+        size_t materialBytes = (size_t)header.materialCount * sizeof(std::uint32_t);
+        if ((size_t)(end - cursor) < materialBytes) {
+            throw std::runtime_error("Unexpected end of encoded mesh.");
+        }
+        mesh.materials.resize(header.materialCount);
+        std::memcpy(mesh.materials.data(), cursor, materialBytes);
+        cursor += materialBytes;
+
+        decodeAttribute(cursor, end, header.vertexCount, mesh.vertexPositions);
+        if (header.flags & HasTextureCoords)
+            decodeAttribute(cursor, end, header.vertexCount, mesh.vertexTextureCoords);
+        if (header.flags & HasNormals)
+            decodeAttribute(cursor, end, header.vertexCount, mesh.vertexNormals);
+        if (header.flags & HasTangents)
+            decodeAttribute(cursor, end, header.vertexCount, mesh.vertexTangents);
+        if (header.flags & HasMaterialIDs) {
+            mesh.vertexMaterialIDs.resize(header.vertexCount);
+            decodeStream(cursor, end, header.vertexCount, mesh.vertexMaterialIDs.data());
+        }
+
+        mesh.vertexIndices.resize(header.indexCount);
+        decodeStream(cursor, end, header.indexCount, mesh.vertexIndices.data());
+        for (std::uint32_t index : mesh.vertexIndices) {
+            if (index >= header.vertexCount) {
+                throw std::runtime_error("Invalid encoded mesh index.");
+            }
+        }
+
+        return mesh;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "FBXFileLoader.hpp"
+
+namespace fbx {
+	/// <summary>
+	/// The version of the encoded mesh format, meshes with any other version are rejected
+	/// </summary>
+	const std::uint32_t meshCodecVersion = 2;
+
+	/// <summary>
+	/// Encodes the vertex and index streams of a mesh into a compact buffer.
+	/// The triangles are reordered for the post transform vertex cache, the vertices are reordered by first
+	/// use in the new index buffer and the indices are stored as zigzag coded deltas. Every stream is split
+	/// into byte planes after delta coding along the vertices, planes holding only zeros are left out (except
+	/// the lowest). The float attributes are delta coded on their raw bit patterns, which for neighbours with
+	/// the same sign and exponent is the difference of their mantissas. Their low mantissa bits stay noisy
+	/// since the coding is lossless, so those planes mostly shrink in the optional entropy stage, which
+	/// deflates the whole buffer. Quantized meshes are rejected since the codec works on the float vertex data.
+	/// </summary>
+	/// <param name="mesh">The mesh to encode</param>
+	/// <param name="entropyCoding">Deflate the coded streams</param>
+	/// <returns>The encoded mesh</returns>
+	std::vector<char> encodeMesh(const Mesh& mesh, bool entropyCoding = true);
+
+	/// <summary>
+	/// Decodes a mesh encoded with encodeMesh. The triangles and vertices come back in the order they
+	/// were encoded in (cache order and first use), with the same winding and bit exact attribute values.
+	/// </summary>
+	/// <param name="data">The encoded mesh</param>
+	/// <param name="size">The size of the encoded mesh in bytes</param>
+	/// <returns>The decoded mesh</returns>
+	Mesh decodeMesh(const char* data, size_t size);
+}
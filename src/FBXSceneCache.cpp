@@ -0,0 +1,533 @@
+#include "FBXSceneCache.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+namespace fbx {
+
+    namespace {
+        // Every block of data in the file starts on this boundary
+        const std::uint64_t cacheAlignment = 16;
+        const char cacheMagic[8] = { 'F', 'B', 'X', 'S', 'C', 'E', 'N', 'E' };
+
+        // Written in native order, a reader with the other byte order sees it swapped
+        const std::uint32_t cacheByteOrder = 0x01020304;
+
+        static_assert(sizeof(glm::vec2) == 8 && sizeof(glm::vec3) == 12 && sizeof(glm::vec4) == 16,
+            "The scene cache stores the glm vectors tightly packed.");
+
+        /// <summary>
+        /// The location of an array in the file
+        /// </summary>
+        struct CacheArray
+        {
+            std::uint64_t offset;
+            std::uint64_t count;
+        };
+
+        /// <summary>
+        /// The start of the file, locating the tables of meshes, materials, textures and lights
+        /// </summary>
+        struct CacheHeader
+        {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byteOrder;
+            std::uint64_t fileSize;
+            CacheArray meshes;
+            CacheArray materials;
+            CacheArray textures[4];		// Diffuse, specular, normal and emissive
+            CacheArray lights;
+            CacheArray meshFingerprints;
+            CacheArray instances;
+        };
+        static_assert(sizeof(CacheHeader) == 168, "Unexpected scene cache header layout.");
+
+        // The arrays of a mesh in the order they are stored
+        enum MeshArray {
+            Materials, Positions, TextureCoords, Normals, Tangents, MaterialIDs, Indices,
+            QuantizedPositions, QuantizedTextureCoords, QuantizedNormals, QuantizedTangents, QuantizedMaterialIDs8, QuantizedMaterialIDs16,
+            MeshArrayCount
+        };
+
+        struct CacheMesh
+        {
+            CacheArray arrays[MeshArrayCount];
+            float positionOffset[3];
+            float positionScale[3];
+            float textureCoordOffset[2];
+            float textureCoordScale[2];
+            std::uint32_t padding[2];
+        };
+        static_assert(sizeof(CacheMesh) == 256, "Unexpected scene cache mesh layout.");
+
+        struct CacheMaterial
+        {
+            CacheArray name;
+            std::uint32_t textureIDs[4];
+            std::uint32_t isAlphaMapped;
+            std::uint32_t padding;
+        };
+
+        struct CacheTexture
+        {
+            CacheArray filePath;
+            std::uint32_t isEmpty;
+            std::uint32_t padding;
+        };
+
+        struct CacheLight
+        {
+            std::uint32_t isPointLight;
+            float location[3];
+            float colour[3];
+            float direction[16];
+            std::uint32_t padding;
+        };
+        static_assert(sizeof(CacheLight) == 96, "Unexpected scene cache light layout.");
+
+        struct CacheInstance
+        {
+            std::uint32_t meshID;
+            float transform[16];
+            std::uint32_t padding[3];
+        };
+        static_assert(sizeof(CacheInstance) == 80, "Unexpected scene cache instance layout.");
+
+        std::uint64_t alignOffset(std::uint64_t offset) {
+            return (offset + cacheAlignment - 1) & ~(cacheAlignment - 1);
+        }
+
+        /// <summary>
+        /// Gives each block of data an aligned offset in the file, then writes them in order
+        /// </summary>
+        struct CacheWriter
+        {
+            struct Block
+            {
+                std::uint64_t offset;
+                const void* data;
+                std::uint64_t size;
+            };
+
+            std::uint64_t end = 0;
+            std::vector<Block> blocks;
+
+            CacheArray place(const void* data, std::uint64_t count, std::uint64_t elementSize) {
+                CacheArray array{ alignOffset(end), count };
+                blocks.push_back({ array.offset, data, count * elementSize });
+                end = array.offset + count * elementSize;
+                return array;
+            }
+
+            template<typename T>
+            CacheArray place(const std::vector<T>& values) {
+                return place(values.data(), values.size(), sizeof(T));
+            }
+
+            CacheArray place(const std::string& text) {
+                return place(text.data(), text.size(), 1);
+            }
+
+            void write(std::ofstream& stream) const {
+                static const char zeros[cacheAlignment] = {};
+                std::uint64_t position = 0;
+                for (const Block& block : blocks) {
+                    stream.write(zeros, (std::streamsize)(block.offset - position));
+                    stream.write((const char*)block.data, (std::streamsize)block.size);
+                    position = block.offset + block.size;
+                }
+            }
+        };
+
+        /// <summary>
+        /// Reads the blocks of a mapped cache file with bounds and alignment checks
+        /// </summary>
+        struct CacheReader
+        {
+            const char* data;
+            std::uint64_t size;
+
+            const char* getBytes(const CacheArray& array, std::uint64_t elementSize, std::uint64_t alignment) const {
+                if (array.offset > size || array.count > (size - array.offset) / elementSize || array.offset % alignment != 0) {
+                    throw std::runtime_error("Invalid scene cache array.");
+                }
+                return data + array.offset;
+            }
+
+            template<typename T>
+            std::span<const T> getArray(const CacheArray& array) const {
+                return std::span<const T>((const T*)getBytes(array, sizeof(T), alignof(T)), (size_t)array.count);
+            }
+
+            std::string getString(const CacheArray& array) const {
+                return std::string(getBytes(array, 1, 1), (size_t)array.count);
+            }
+
+            template<typename T>
+            std::vector<T> getTable(const CacheArray& array) const {
+                std::vector<T> table((size_t)array.count);
+                std::memcpy(table.data(), getBytes(array, sizeof(T), cacheAlignment), sizeof(T) * table.size());
+                return table;
+            }
+        };
+
+        std::uint64_t rotateLeft(std::uint64_t value, int bits) {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        /// <summary>
+        /// Spreads every input bit over the whole hash
+        /// </summary>
+        std::uint64_t mixHash(std::uint64_t hash) {
+            hash ^= hash >> 33;
+            hash *= 0xff51afd7ed558ccdull;
+            hash ^= hash >> 33;
+            hash *= 0xc4ceb9fe1a85ec53ull;
+            hash ^= hash >> 33;
+            return hash;
+        }
+
+        std::string getCachePath(const std::string& cacheDirectory, std::uint64_t key) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.fbxcache", (unsigned long long)key);
+            return (std::filesystem::path(cacheDirectory) / name).string();
+        }
+
+        /// <summary>
+        /// Gets the texture sets of a scene in the order they are stored
+        /// </summary>
+        template<typename SceneType>
+        auto getTextureSets(SceneType& scene) {
+            return std::array<decltype(&scene.diffuseTextures), 4>{
+                &scene.diffuseTextures, &scene.specularTextures, &scene.normalTextures, &scene.emissiveTextures };
+        }
+    }
+
+    SceneCache::SceneCache(const char* filename)
+        : file(filename) {
+
+        CacheReader reader{ file.data(), file.size() };
+
+        // Check the header before trusting any of the offsets
+        CacheHeader header;
+        if (file.size() < sizeof(header)) {
+            throw std::runtime_error("File is not a scene cache.");
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0) {
+            throw std::runtime_error("File is not a scene cache.");
+        }
+        if (header.version != sceneCacheVersion || header.byteOrder != cacheByteOrder) {
+            throw std::runtime_error("Unsupported scene cache version.");
+        }
+        if (header.fileSize != file.size()) {
+            throw std::runtime_error("Scene cache file is truncated.");
+        }
+
+        // The small parts of the scene are copied out
+        for (const CacheMaterial& entry : reader.getTable<CacheMaterial>(header.materials)) {
+            Material material;
+            material.materialName = reader.getString(entry.name);
+            material.diffuseTextureID = entry.textureIDs[0];
+            material.specularTextureID = entry.textureIDs[1];
+            material.normalTextureID = entry.textureIDs[2];
+            material.emissiveTextureID = entry.textureIDs[3];
+            material.isAlphaMapped = entry.isAlphaMapped != 0;
+            sceneData.materials.emplace_back(std::move(material));
+        }
+
+        auto textureSets = getTextureSets(sceneData);
+        for (size_t set = 0; set < textureSets.size(); set++) {
+            for (const CacheTexture& entry : reader.getTable<CacheTexture>(header.textures[set])) {
+                Texture texture;
+                texture.filePath = reader.getString(entry.filePath);
+                texture.isEmpty = entry.isEmpty != 0;
+                textureSets[set]->emplace_back(std::move(texture));
+            }
+        }
+
+        for (const CacheLight& entry : reader.getTable<CacheLight>(header.lights)) {
+            Light light;
+            light.isPointLight = entry.isPointLight != 0;
+            std::memcpy(&light.location, entry.location, sizeof(entry.location));
+            std::memcpy(&light.colour, entry.colour, sizeof(entry.colour));
+            std::memcpy(&light.direction, entry.direction, sizeof(entry.direction));
+            sceneData.lights.emplace_back(light);
+        }
+
+        for (const CacheInstance& entry : reader.getTable<CacheInstance>(header.instances)) {
+            MeshInstance instance;
+            instance.meshID = entry.meshID;
+            std::memcpy(&instance.transform, entry.transform, sizeof(entry.transform));
+            sceneData.instances.emplace_back(instance);
+        }
+
+        // The mesh arrays are used where they are in the file
+        for (const CacheMesh& entry : reader.getTable<CacheMesh>(header.meshes)) {
+            CachedMesh mesh;
+            mesh.materials = reader.getArray<uint32_t>(entry.arrays[Materials]);
+            mesh.vertexPositions = reader.getArray<glm::vec3>(entry.arrays[Positions]);
+            mesh.vertexTextureCoords = reader.getArray<glm::vec2>(entry.arrays[TextureCoords]);
+            mesh.vertexNormals = reader.getArray<glm::vec3>(entry.arrays[Normals]);
+            mesh.vertexTangents = reader.getArray<glm::vec4>(entry.arrays[Tangents]);
+            mesh.vertexMaterialIDs = reader.getArray<uint32_t>(entry.arrays[MaterialIDs]);
+            mesh.vertexIndices = reader.getArray<uint32_t>(entry.arrays[Indices]);
+
+            std::memcpy(&mesh.positionOffset, entry.positionOffset, sizeof(entry.positionOffset));
+            std::memcpy(&mesh.positionScale, entry.positionScale, sizeof(entry.positionScale));
+            std::memcpy(&mesh.textureCoordOffset, entry.textureCoordOffset, sizeof(entry.textureCoordOffset));
+            std::memcpy(&mesh.textureCoordScale, entry.textureCoordScale, sizeof(entry.textureCoordScale));
+            mesh.quantizedPositions = reader.getArray<glm::u16vec3>(entry.arrays[QuantizedPositions]);
+            mesh.quantizedTextureCoords = reader.getArray<glm::u16vec2>(entry.arrays[QuantizedTextureCoords]);
+            mesh.quantizedNormals = reader.getArray<glm::i16vec2>(entry.arrays[QuantizedNormals]);
+            mesh.quantizedTangents = reader.getArray<glm::i16vec2>(entry.arrays[QuantizedTangents]);
+            mesh.quantizedMaterialIDs8 = reader.getArray<std::uint8_t>(entry.arrays[QuantizedMaterialIDs8]);
+            mesh.quantizedMaterialIDs16 = reader.getArray<std::uint16_t>(entry.arrays[QuantizedMaterialIDs16]);
+            meshes.emplace_back(mesh);
+        }
+
+        for (const MeshInstance& instance : sceneData.instances) {
+            if (instance.meshID >= meshes.size()) {
+                throw std::runtime_error("Invalid scene cache mesh instance.");
+            }
+        }
+
+        meshFingerprints = reader.getArray<std::uint64_t>(header.meshFingerprints);
+        if (!meshFingerprints.empty() && meshFingerprints.size() != meshes.size()) {
+            throw std::runtime_error("Invalid scene cache mesh fingerprints.");
+        }
+    }
+
+    Scene SceneCache::toScene() const {
+        Scene scene = sceneData;
+
+        scene.meshes.resize(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const CachedMesh& cached = meshes[i];
+            Mesh& mesh = scene.meshes[i];
+            mesh.materials.assign(cached.materials.begin(), cached.materials.end());
+            mesh.vertexPositions.assign(cached.vertexPositions.begin(), cached.vertexPositions.end());
+            mesh.vertexTextureCoords.assign(cached.vertexTextureCoords.begin(), cached.vertexTextureCoords.end());
+            mesh.vertexNormals.assign(cached.vertexNormals.begin(), cached.vertexNormals.end());
+            mesh.vertexTangents.assign(cached.vertexTangents.begin(), cached.vertexTangents.end());
+            mesh.vertexMaterialIDs.assign(cached.vertexMaterialIDs.begin(), cached.vertexMaterialIDs.end());
+            mesh.vertexIndices.assign(cached.vertexIndices.begin(), cached.vertexIndices.end());
+
+            QuantizedVertices& quantized = mesh.quantized;
+            quantized.positionOffset = cached.positionOffset;
+            quantized.positionScale = cached.positionScale;
+            quantized.textureCoordOffset = cached.textureCoordOffset;
+            quantized.textureCoordScale = cached.textureCoordScale;
+            quantized.vertexPositions.assign(cached.quantizedPositions.begin(), cached.quantizedPositions.end());
+            quantized.vertexTextureCoords.assign(cached.quantizedTextureCoords.begin(), cached.quantizedTextureCoords.end());
+            quantized.vertexNormals.assign(cached.quantizedNormals.begin(), cached.quantizedNormals.end());
+            quantized.vertexTangents.assign(cached.quantizedTangents.begin(), cached.quantizedTangents.end());
+            quantized.vertexMaterialIDs8.assign(cached.quantizedMaterialIDs8.begin(), cached.quantizedMaterialIDs8.end());
+            quantized.vertexMaterialIDs16.assign(cached.quantizedMaterialIDs16.begin(), cached.quantizedMaterialIDs16.end());
+        }
+
+        return scene;
+    }
+
+    void writeSceneCache(const char* filename, const Scene& scene, const std::vector<std::uint64_t>& meshFingerprints) {
+        CacheWriter writer;
+
+        CacheHeader header{};
+        std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.version = sceneCacheVersion;
+        header.byteOrder = cacheByteOrder;
+        writer.place(&header, 1, sizeof(header));
+
+        // Place the tables first, their entries are filled in as the data they point to is placed
+        std::vector<CacheMesh> meshTable(scene.meshes.size());
+        std::vector<CacheMaterial> materialTable(scene.materials.size());
+        std::vector<CacheLight> lightTable(scene.lights.size());
+        std::array<std::vector<CacheTexture>, 4> textureTables;
+
+        auto textureSets = getTextureSets(scene);
+        for (size_t set = 0; set < textureSets.size(); set++) {
+            textureTables[set].resize(textureSets[set]->size());
+        }
+
+        header.meshes = writer.place(meshTable);
+        header.materials = writer.place(materialTable);
+        for (size_t set = 0; set < textureTables.size(); set++) {
+            header.textures[set] = writer.place(textureTables[set]);
+        }
+        header.lights = writer.place(lightTable);
+
+        std::vector<CacheInstance> instanceTable(scene.instances.size());
+        for (size_t i = 0; i < scene.instances.size(); i++) {
+            instanceTable[i].meshID = scene.instances[i].meshID;
+            std::memcpy(instanceTable[i].transform, &scene.instances[i].transform, sizeof(instanceTable[i].transform));
+        }
+        header.instances = writer.place(instanceTable);
+
+        for (size_t i = 0; i < scene.materials.size(); i++) {
+            const Material& material = scene.materials[i];
+            CacheMaterial& entry = materialTable[i];
+            entry.name = writer.place(material.materialName);
+            entry.textureIDs[0] = material.diffuseTextureID;
+            entry.textureIDs[1] = material.specularTextureID;
+            entry.textureIDs[2] = material.normalTextureID;
+            entry.textureIDs[3] = material.emissiveTextureID;
+            entry.isAlphaMapped = material.isAlphaMapped ? 1 : 0;
+        }
+
+        for (size_t set = 0; set < textureSets.size(); set++) {
+            for (size_t i = 0; i < textureSets[set]->size(); i++) {
+                const Texture& texture = (*textureSets[set])[i];
+                textureTables[set][i].filePath = writer.place(texture.filePath);
+                textureTables[set][i].isEmpty = texture.isEmpty ? 1 : 0;
+            }
+        }
+
+        for (size_t i = 0; i < scene.lights.size(); i++) {
+            const Light& light = scene.lights[i];
+            CacheLight& entry = lightTable[i];
+            entry.isPointLight = light.isPointLight ? 1 : 0;
+            std::memcpy(entry.location, &light.location, sizeof(entry.location));
+            std::memcpy(entry.colour, &light.colour, sizeof(entry.colour));
+            std::memcpy(entry.direction, &light.direction, sizeof(entry.direction));
+        }
+
+        for (size_t i = 0; i < scene.meshes.size(); i++) {
+            const Mesh& mesh = scene.meshes[i];
+            CacheMesh& entry = meshTable[i];
+            entry.arrays[Materials] = writer.place(mesh.materials);
+            entry.arrays[Positions] = writer.place(mesh.vertexPositions);
+            entry.arrays[TextureCoords] = writer.place(mesh.vertexTextureCoords);
+            entry.arrays[Normals] = writer.place(mesh.vertexNormals);
+            entry.arrays[Tangents] = writer.place(mesh.vertexTangents);
+            entry.arrays[MaterialIDs] = writer.place(mesh.vertexMaterialIDs);
+            entry.arrays[Indices] = writer.place(mesh.vertexIndices);
+
+            const QuantizedVertices& quantized = mesh.quantized;
+            std::memcpy(entry.positionOffset, &quantized.positionOffset, sizeof(entry.positionOffset));
+            std::memcpy(entry.positionScale, &quantized.positionScale, sizeof(entry.positionScale));
+            std::memcpy(entry.textureCoordOffset, &quantized.textureCoordOffset, sizeof(entry.textureCoordOffset));
+            std::memcpy(entry.textureCoordScale, &quantized.textureCoordScale, sizeof(entry.textureCoordScale));
+            entry.arrays[QuantizedPositions] = writer.place(quantized.vertexPositions);
+            entry.arrays[QuantizedTextureCoords] = writer.place(quantized.vertexTextureCoords);
+            entry.arrays[QuantizedNormals] = writer.place(quantized.vertexNormals);
+            entry.arrays[QuantizedTangents] = writer.place(quantized.vertexTangents);
+            entry.arrays[QuantizedMaterialIDs8] = writer.place(quantized.vertexMaterialIDs8);
+            entry.arrays[QuantizedMaterialIDs16] = writer.place(quantized.vertexMaterialIDs16);
+        }
+
+        header.meshFingerprints = writer.place(meshFingerprints);
+
+        header.fileSize = writer.end;
+
+        std::ofstream stream(filename, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            throw std::runtime_error("Failed to create the scene cache file.");
+        }
+        writer.write(stream);
+        if (!stream) {
+            throw std::runtime_error("Failed to write the scene cache file.");
+        }
+    }
+
+    Scene readSceneCache(const char* filename) {
+        return SceneCache(filename).toScene();
+    }
+
+    std::uint64_t hashBytes(const char* data, size_t size, std::uint64_t seed) {
+        const std::uint64_t prime = 0x9e3779b97f4a7c15ull;
+
+        // Four independent lanes keep several multiplies in flight
+        std::uint64_t lanes[4] = { seed, seed + prime, seed - prime, seed ^ 0x5851f42d4c957f2dull };
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            for (int lane = 0; lane < 4; lane++) {
+                std::uint64_t word;
+                std::memcpy(&word, data + i + lane * 8, sizeof(word));
+                lanes[lane] = rotateLeft(lanes[lane] ^ (word * prime), 31) * prime;
+            }
+        }
+
+        std::uint64_t hash = (std::uint64_t)size * prime;
+        for (int lane = 0; lane < 4; lane++) {
+            hash = rotateLeft(hash ^ mixHash(lanes[lane]), 27) * prime;
+        }
+        for (; i < size; i++) {
+            hash = (hash ^ (std::uint8_t)data[i]) * 0x100000001b3ull;
+        }
+        return mixHash(hash);
+    }
+
+    std::uint64_t hashLoadOptions(const LoadOptions& options) {
+        std::uint64_t settings[] = {
+            loaderVersion,
+            (std::uint64_t)options.loadLights,
+            (std::uint64_t)options.loadMaterials,
+            (std::uint64_t)options.loadTextures,
+            (std::uint64_t)options.loadNormals,
+            (std::uint64_t)options.loadTextureCoords,
+            (std::uint64_t)options.loadTangents,
+            (std::uint64_t)options.quantizeVertices,
+            (std::uint64_t)options.instanceGeometry,
+        };
+
+        // The tolerances are hashed by their bit patterns
+        const WeldTolerances& tolerances = options.weldTolerances;
+        float weldSettings[] = { tolerances.position, tolerances.normalAngle, tolerances.textureCoord };
+        std::uint64_t hash = hashBytes((const char*)settings, sizeof(settings));
+        return hashBytes((const char*)weldSettings, sizeof(weldSettings), hash);
+    }
+
+    std::uint64_t getSceneCacheKey(const char* filename, const LoadOptions& options) {
+        MappedFile file(filename);
+        return getSceneCacheKey(file.data(), file.size(), options);
+    }
+
+    std::uint64_t getSceneCacheKey(const char* data, size_t size, const LoadOptions& options) {
+        // Only the cache key depends on the cache format, the mesh fingerprints do not
+        std::uint64_t seed = hashBytes((const char*)&sceneCacheVersion, sizeof(sceneCacheVersion), hashLoadOptions(options));
+        return hashBytes(data, size, seed);
+    }
+
+    bool readCachedScene(const std::string& cacheDirectory, std::uint64_t key, Scene& outScene) {
+        std::string path = getCachePath(cacheDirectory, key);
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error)) {
+            return false;
+        }
+
+        // A damaged or old cache file counts as a miss and is rebuilt
+        try {
+            outScene = readSceneCache(path.c_str());
+        }
+        catch (const std::runtime_error&) {
+            return false;
+        }
+        return true;
+    }
+
+    void writeCachedScene(const std::string& cacheDirectory, std::uint64_t key, const Scene& scene) {
+        std::filesystem::create_directories(cacheDirectory);
+
+        // Each writer uses its own temporary file so processes sharing the directory do not collide
+        std::string path = getCachePath(cacheDirectory, key);
+        std::random_device random;
+        std::string temporaryPath = path + "." + std::to_string(((std::uint64_t)random() << 32) | random()) + ".tmp";
+
+        try {
+            writeSceneCache(temporaryPath.c_str(), scene);
+            std::filesystem::rename(temporaryPath, path);
+        }
+        catch (...) {
+            std::error_code error;
+            std::filesystem::remove(temporaryPath, error);
+            throw;
+        }
+    }
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "FBXFileLoader.hpp"
+#include "MappedFile.hpp"
+
+namespace fbx {
+	/// <summary>
+	/// The version of the scene cache format, files with any other version are rejected
+	/// </summary>
+	const std::uint32_t sceneCacheVersion = 4;
+
+	/// <summary>
+	/// The arrays of a mesh in a scene cache, pointing straight into the mapped cache file
+	/// </summary>
+	struct CachedMesh
+	{
+		std::span<const uint32_t> materials;
+
+		std::span<const glm::vec3> vertexPositions;
+		std::span<const glm::vec2> vertexTextureCoords;
+		std::span<const glm::vec3> vertexNormals;
+		std::span<const glm::vec4> vertexTangents;
+		std::span<const uint32_t> vertexMaterialIDs;
+
+		std::span<const uint32_t> vertexIndices;
+
+		// The quantized vertex data, see QuantizedVertices
+		glm::vec3 positionOffset;
+		glm::vec3 positionScale;
+		glm::vec2 textureCoordOffset;
+		glm::vec2 textureCoordScale;
+		std::span<const glm::u16vec3> quantizedPositions;
+		std::span<const glm::u16vec2> quantizedTextureCoords;
+		std::span<const glm::i16vec2> quantizedNormals;
+		std::span<const glm::i16vec2> quantizedTangents;
+		std::span<const std::uint8_t> quantizedMaterialIDs8;
+		std::span<const std::uint16_t> quantizedMaterialIDs16;
+	};
+
+	/// <summary>
+	/// A memory mapped scene cache file. Every array in the file is aligned so the meshes
+	/// are used in place, only the materials, textures, lights and instances are copied when it is opened.
+	/// </summary>
+	class SceneCache
+	{
+	public:
+		/// <summary>
+		/// Maps a scene cache file and checks its header
+		/// </summary>
+		/// <param name="filename">The cache file path</param>
+		explicit SceneCache(const char* filename);
+
+		size_t getMeshCount() const { return meshes.size(); }
+		const CachedMesh& getMesh(size_t meshIndex) const { return meshes.at(meshIndex); }
+
+		/// <summary>
+		/// Gets the scene without its meshes (the materials, texture sets, lights and mesh instances)
+		/// </summary>
+		const Scene& getSceneData() const { return sceneData; }
+
+		/// <summary>
+		/// Gets the fingerprints of the meshes stored with the scene (empty if none were stored)
+		/// </summary>
+		std::span<const std::uint64_t> getMeshFingerprints() const { return meshFingerprints; }
+
+		/// <summary>
+		/// Copies the cache into a scene, each array is copied as a single block
+		/// </summary>
+		/// <returns>A Scene structure</returns>
+		Scene toScene() const;
+
+	private:
+		MappedFile file;
+		Scene sceneData;
+		std::vector<CachedMesh> meshes;
+		std::span<const std::uint64_t> meshFingerprints;
+	};
+
+	/// <summary>
+	/// Hashes a block of memory, 32 bytes at a time
+	/// </summary>
+	/// <param name="data">The bytes to hash</param>
+	/// <param name="size">The number of bytes</param>
+	/// <param name="seed">The starting value of the hash</param>
+	/// <returns>A 64 bit hash</returns>
+	std::uint64_t hashBytes(const char* data, size_t size, std::uint64_t seed = 0);
+
+	/// <summary>
+	/// Hashes the load options that change the loaded data, with the loader version
+	/// </summary>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>A 64 bit hash</returns>
+	std::uint64_t hashLoadOptions(const LoadOptions& options);
+
+	/// <summary>
+	/// Gets the cache key of a file loaded with the given options, from the file contents,
+	/// the options and the loader and cache format versions
+	/// </summary>
+	/// <param name="filename">The .fbx file path</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>The key naming the cache file</returns>
+	std::uint64_t getSceneCacheKey(const char* filename, const LoadOptions& options);
+
+	/// <summary>
+	/// Gets the cache key of a file held in memory loaded with the given options
+	/// </summary>
+	/// <param name="data">The file contents</param>
+	/// <param name="size">The size of the file in bytes</param>
+	/// <param name="options">Which parts of the file to load</param>
+	/// <returns>The key naming the cache file</returns>
+	std::uint64_t getSceneCacheKey(const char* data, size_t size, const LoadOptions& options);
+
+	/// <summary>
+	/// Reads the cached scene with the given key from a cache directory
+	/// </summary>
+	/// <param name="cacheDirectory">The cache directory</param>
+	/// <param name="key">The key from getSceneCacheKey</param>
+	/// <param name="outScene">The cached scene</param>
+	/// <returns>False if there is no valid cache file for the key</returns>
+	bool readCachedScene(const std::string& cacheDirectory, std::uint64_t key, Scene& outScene);
+
+	/// <summary>
+	/// Writes a scene to a cache directory. The file is written under a temporary name and
+	/// renamed into place so other processes never see a partly written cache.
+	/// </summary>
+	/// <param name="cacheDirectory">The cache directory, created if needed</param>
+	/// <param name="key">The key from getSceneCacheKey</param>
+	/// <param name="scene">The scene to store</param>
+	void writeCachedScene(const std::string& cacheDirectory, std::uint64_t key, const Scene& scene);
+
+	/// <summary>
+	/// Writes a scene to a cache file
+	/// </summary>
+	/// <param name="filename">The cache file path</param>
+	/// <param name="scene">The scene to store</param>
+	/// <param name="meshFingerprints">The fingerprints of the scene meshes for reloadFBXFile, may be empty</param>
+	void writeSceneCache(const char* filename, const Scene& scene, const std::vector<std::uint64_t>& meshFingerprints = {});
+
+	/// <summary>
+	/// Reads a scene cache file written by writeSceneCache
+	/// </summary>
+	/// <param name="filename">The cache file path</param>
+	/// <returns>A Scene structure</returns>
+	Scene readSceneCache(const char* filename);
+}
@@ -0,0 +1,268 @@
+#include "FBXSceneGraph.hpp"
+
+#include "gtc/matrix_transform.hpp"
+
+#include <stdexcept>
+
+namespace fbx {
+
+    namespace {
+        /// <summary>
+        /// Builds a rotation matrix from euler angles in degrees applied in the given FBX rotation order
+        /// </summary>
+        glm::dmat4 eulerToMatrix(glm::dvec3 degrees, int rotationOrder) {
+            glm::dmat4 x = glm::rotate(glm::dmat4(1), glm::radians(degrees.x), glm::dvec3(1, 0, 0));
+            glm::dmat4 y = glm::rotate(glm::dmat4(1), glm::radians(degrees.y), glm::dvec3(0, 1, 0));
+            glm::dmat4 z = glm::rotate(glm::dmat4(1), glm::radians(degrees.z), glm::dvec3(0, 0, 1));
+
+            // The first axis in the order is applied first
+            switch (rotationOrder) {
+            case 1: return y * z * x;    // XZY
+            case 2: return x * z * y;    // YZX
+            case 3: return z * x * y;    // YXZ
+            case 4: return y * x * z;    // ZXY
+            case 5: return x * y * z;    // ZYX
+            default: return z * y * x;   // XYZ
+            }
+        }
+
+        enum class VisitState : std::uint8_t { NotVisited, InProgress, Done };
+
+        void evaluateGlobalTransforms(SceneGraph& graph, size_t nodeIndex, const glm::dmat4& parentTransform, std::vector<VisitState>& states) {
+            // A node reached again while its own subtree is being evaluated means the connections form a loop
+            if (states[nodeIndex] == VisitState::InProgress) {
+                throw std::runtime_error("FBX file has a cycle in the node hierarchy.");
+            }
+            states[nodeIndex] = VisitState::InProgress;
+
+            SceneNode& node = graph.nodes[nodeIndex];
+
+            glm::dmat4 globalTransform = parentTransform;
+            if (node.model != nullptr) {
+                globalTransform = parentTransform * evaluateLocalTransform(*node.model, graph);
+            }
+            node.globalTransform = glm::mat4(globalTransform);
+
+            for (size_t child : node.children) {
+                evaluateGlobalTransforms(graph, child, globalTransform, states);
+            }
+            states[nodeIndex] = VisitState::Done;
+        }
+    }
+
+    const Node* SceneGraph::findSourceObject(std::int64_t destination, std::string_view property) const {
+        auto sources = sourceConnections.find(destination);
+        if (sources == sourceConnections.end()) {
+            return nullptr;
+        }
+        for (size_t connectionIndex : sources->second) {
+            const Connection& connection = connections[connectionIndex];
+            if (connection.property == property) {
+                auto object = objects.find(connection.source);
+                if (object != objects.end()) {
+                    return object->second;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    const Node* SceneGraph::findProperty(const Node& object, std::string_view templateName, std::string_view propertyName) const {
+        // Look in the object first then in the template for the object type
+        const Node* propertyLists[2] = { object.findChild("Properties70"), nullptr };
+        auto propertyTemplate = propertyTemplates.find(std::string(templateName));
+        if (propertyTemplate != propertyTemplates.end()) {
+            propertyLists[1] = propertyTemplate->second;
+        }
+
+        for (const Node* propertyList : propertyLists) {
+            if (propertyList == nullptr) {
+                continue;
+            }
+            for (const Node& property : propertyList->children) {
+                if (!property.properties.empty() && property.properties[0].stringValue == propertyName) {
+                    return &property;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    double SceneGraph::getNumber(const Node& object, std::string_view templateName, std::string_view propertyName, double defaultValue) const {
+        // P records are: name, type, sub type, flags, value(s)
+        const Node* property = findProperty(object, templateName, propertyName);
+        if (property == nullptr || property->properties.size() < 5) {
+            return defaultValue;
+        }
+        return property->properties[4].asReal();
+    }
+
+    glm::dvec3 SceneGraph::getVector(const Node& object, std::string_view templateName, std::string_view propertyName, glm::dvec3 defaultValue) const {
+        const Node* property = findProperty(object, templateName, propertyName);
+        if (property == nullptr || property->properties.size() < 7) {
+            return defaultValue;
+        }
+        return glm::dvec3(
+            property->properties[4].asReal(),
+            property->properties[5].asReal(),
+            property->properties[6].asReal());
+    }
+
+    std::string getObjectName(const Node& object) {
+        if (object.properties.size() < 2) {
+            return std::string();
+        }
+        std::string_view name = object.properties[1].stringValue;
+
+        // Binary files store "Name\x00\x01Class" and ASCII files store "Class::Name"
+        size_t separator = name.find(std::string_view("\x00\x01", 2));
+        if (separator != std::string_view::npos) {
+            return std::string(name.substr(0, separator));
+        }
+        separator = name.find("::");
+        if (separator != std::string_view::npos) {
+            return std::string(name.substr(separator + 2));
+        }
+        return std::string(name);
+    }
+
+    std::string_view getObjectClass(const Node& object) {
+        if (object.properties.size() < 3) {
+            return std::string_view();
+        }
+        return object.properties[2].stringValue;
+    }
+
+    glm::dmat4 evaluateLocalTransform(const Node& model, const SceneGraph& graph) {
+        const char* nodeTemplate = "FbxNode";
+
+        glm::dvec3 translation = graph.getVector(model, nodeTemplate, "Lcl Translation", glm::dvec3(0));
+        glm::dvec3 rotation = graph.getVector(model, nodeTemplate, "Lcl Rotation", glm::dvec3(0));
+        glm::dvec3 scaling = graph.getVector(model, nodeTemplate, "Lcl Scaling", glm::dvec3(1));
+
+        glm::dvec3 rotationOffset = graph.getVector(model, nodeTemplate, "RotationOffset", glm::dvec3(0));
+        glm::dvec3 rotationPivot = graph.getVector(model, nodeTemplate, "RotationPivot", glm::dvec3(0));
+        glm::dvec3 scalingOffset = graph.getVector(model, nodeTemplate, "ScalingOffset", glm::dvec3(0));
+        glm::dvec3 scalingPivot = graph.getVector(model, nodeTemplate, "ScalingPivot", glm::dvec3(0));
+
+        int rotationOrder = (int)graph.getNumber(model, nodeTemplate, "RotationOrder", 0);
+
+        // Pre and post rotations are only used when the rotation is active
+        glm::dmat4 preRotation(1), postRotation(1);
+        if (graph.getNumber(model, nodeTemplate, "RotationActive", 0) != 0) {
+            preRotation = eulerToMatrix(graph.getVector(model, nodeTemplate, "PreRotation", glm::dvec3(0)), 0);
+            postRotation = eulerToMatrix(graph.getVector(model, nodeTemplate, "PostRotation", glm::dvec3(0)), 0);
+        }
+
+        // Local = T * Roff * Rp * Rpre * R * Rpost^-1 * Rp^-1 * Soff * Sp * S * Sp^-1
+        glm::dmat4 identity(1);
+        return glm::translate(identity, translation)
+            * glm::translate(identity, rotationOffset)
+            * glm::translate(identity, rotationPivot)
+            * preRotation
+            * eulerToMatrix(rotation, rotationOrder)
+            * glm::inverse(postRotation)
+            * glm::translate(identity, -rotationPivot)
+            * glm::translate(identity, scalingOffset)
+            * glm::translate(identity, scalingPivot)
+            * glm::scale(identity, scaling)
+            * glm::translate(identity, -scalingPivot);
+    }
+
+    SceneGraph buildSceneGraph(Document document) {
+        SceneGraph graph;
+        graph.document = std::move(document);
+
+        // Gather the property templates from the definitions
+        if (const Node* definitions = graph.document.findNode("Definitions")) {
+            for (const Node& objectType : definitions->children) {
+                if (objectType.name != "ObjectType") {
+                    continue;
+                }
+                for (const Node& propertyTemplate : objectType.children) {
+                    const Node* propertyList = propertyTemplate.findChild("Properties70");
+                    if (propertyTemplate.name == "PropertyTemplate" && !propertyTemplate.properties.empty() && propertyList != nullptr) {
+                        graph.propertyTemplates[std::string(propertyTemplate.properties[0].stringValue)] = propertyList;
+                    }
+                }
+            }
+        }
+
+        // Create the root node and a node for each model
+        graph.nodes.emplace_back();
+        graph.nodes[0].name = "RootNode";
+
+        std::unordered_map<std::int64_t, size_t> modelNodes;
+        modelNodes[0] = 0;
+
+        const Node* objects = graph.document.findNode("Objects");
+        if (objects == nullptr) {
+            throw std::runtime_error("FBX file has no objects.");
+        }
+        for (const Node& object : objects->children) {
+            if (object.properties.empty()) {
+                continue;
+            }
+            std::int64_t id = object.properties[0].asInteger();
+            graph.objects[id] = &object;
+
+            if (object.name == "Model") {
+                SceneNode node;
+                node.id = id;
+                node.name = getObjectName(object);
+                node.model = &object;
+                modelNodes[id] = graph.nodes.size();
+                graph.nodes.emplace_back(std::move(node));
+            }
+        }
+
+        // Link the objects together using the connections
+        if (const Node* connections = graph.document.findNode("Connections")) {
+            for (const Node& record : connections->children) {
+                if (record.name != "C" || record.properties.size() < 3) {
+                    continue;
+                }
+
+                Connection connection;
+                connection.source = record.properties[1].asInteger();
+                connection.destination = record.properties[2].asInteger();
+                if (record.properties.size() > 3) {
+                    connection.property = std::string(record.properties[3].stringValue);
+                }
+                graph.sourceConnections[connection.destination].emplace_back(graph.connections.size());
+                graph.connections.emplace_back(connection);
+
+                // Only object to object connections onto models build the hierarchy
+                auto destination = modelNodes.find(connection.destination);
+                auto source = graph.objects.find(connection.source);
+                if (!connection.property.empty() || destination == modelNodes.end() || source == graph.objects.end()) {
+                    continue;
+                }
+
+                SceneNode& node = graph.nodes[destination->second];
+                const Node& sourceObject = *source->second;
+                if (sourceObject.name == "Model") {
+                    node.children.emplace_back(modelNodes[connection.source]);
+                }
+                else if (sourceObject.name == "Geometry" && getObjectClass(sourceObject) == "Mesh") {
+                    if (node.geometry == nullptr) {
+                        node.geometry = &sourceObject;
+                    }
+                }
+                else if (sourceObject.name == "NodeAttribute" && getObjectClass(sourceObject) == "Light") {
+                    if (node.light == nullptr) {
+                        node.light = &sourceObject;
+                    }
+                }
+                else if (sourceObject.name == "Material") {
+                    node.materials.emplace_back(&sourceObject);
+                }
+            }
+        }
+
+        std::vector<VisitState> states(graph.nodes.size(), VisitState::NotVisited);
+        evaluateGlobalTransforms(graph, 0, glm::dmat4(1), states);
+
+        return graph;
+    }
+}
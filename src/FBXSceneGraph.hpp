@@ -0,0 +1,119 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <glm.hpp>
+
+#include "FBXDocument.hpp"
+
+/// The object graph described by the Objects and Connections sections of an FBX document.
+namespace fbx {
+	/// <summary>
+	/// A model (transform node) in the scene hierarchy
+	/// </summary>
+	struct SceneNode
+	{
+		std::int64_t id = 0;
+		std::string name;
+
+		// The source records attached to the node (nullptr if not present)
+		const Node* model = nullptr;
+		const Node* geometry = nullptr;
+		const Node* light = nullptr;
+		std::vector<const Node*> materials;
+
+		// Indices of the child nodes in the scene graph
+		std::vector<size_t> children;
+
+		glm::mat4 globalTransform = glm::mat4(1);
+	};
+
+	/// <summary>
+	/// A connection from a source object to a destination object
+	/// </summary>
+	struct Connection
+	{
+		std::int64_t source;
+		std::int64_t destination;
+		std::string property;		// Empty for object to object connections
+	};
+
+	/// <summary>
+	/// The objects of an FBX document linked together into a node hierarchy
+	/// </summary>
+	struct SceneGraph
+	{
+		Document document;
+
+		// The model hierarchy, the first node is the root of the scene
+		std::vector<SceneNode> nodes;
+
+		std::unordered_map<std::int64_t, const Node*> objects;
+		std::vector<Connection> connections;
+
+		// Indices into connections of the connections onto each destination object, in file order
+		std::unordered_map<std::int64_t, std::vector<size_t>> sourceConnections;
+
+		// Properties70 records of the property templates, keyed by template name (e.g. FbxNode)
+		std::unordered_map<std::string, const Node*> propertyTemplates;
+
+		/// <summary>
+		/// Finds the first object connected to the given object through a property
+		/// </summary>
+		/// <param name="destination">The id of the object the source connects to</param>
+		/// <param name="property">The property name of the connection</param>
+		/// <returns>The source object or nullptr if there is none</returns>
+		const Node* findSourceObject(std::int64_t destination, std::string_view property) const;
+
+		/// <summary>
+		/// Finds a P record of an object, falling back to the property template
+		/// </summary>
+		/// <param name="object">The object record</param>
+		/// <param name="templateName">The name of the property template for the object</param>
+		/// <param name="propertyName">The name of the property</param>
+		/// <returns>The P record or nullptr if it is not defined</returns>
+		const Node* findProperty(const Node& object, std::string_view templateName, std::string_view propertyName) const;
+
+		/// <summary>
+		/// Gets a numeric property of an object
+		/// </summary>
+		double getNumber(const Node& object, std::string_view templateName, std::string_view propertyName, double defaultValue) const;
+
+		/// <summary>
+		/// Gets a three component property of an object
+		/// </summary>
+		glm::dvec3 getVector(const Node& object, std::string_view templateName, std::string_view propertyName, glm::dvec3 defaultValue) const;
+	};
+
+	/// <summary>
+	/// Links the objects of a document together and evaluates the node transforms
+	/// </summary>
+	/// <param name="document">The parsed FBX document</param>
+	/// <returns>The scene graph which owns the document</returns>
+	SceneGraph buildSceneGraph(Document document);
+
+	/// <summary>
+	/// Gets the name of an object record without the class suffix
+	/// </summary>
+	/// <param name="object">An object record from the Objects section</param>
+	/// <returns>The object name</returns>
+	std::string getObjectName(const Node& object);
+
+	/// <summary>
+	/// Gets the class of an object record (e.g. Mesh, Light, Null)
+	/// </summary>
+	/// <param name="object">An object record from the Objects section</param>
+	/// <returns>The object class</returns>
+	std::string_view getObjectClass(const Node& object);
+
+	/// <summary>
+	/// Evaluates the local transform of a model from its transform properties
+	/// </summary>
+	/// <param name="model">The model record</param>
+	/// <param name="graph">The scene graph the model belongs to</param>
+	/// <returns>The local transform matrix</returns>
+	glm::dmat4 evaluateLocalTransform(const Node& model, const SceneGraph& graph);
+}
@@ -0,0 +1,312 @@
+#include "FBXSpilledScene.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+
+#include "ThreadPool.hpp"
+
+namespace fbx {
+
+    namespace {
+        // The number of arrays in a Mesh, in the order of forEachArray
+        const int meshArrayCount = 13;
+
+        /// <summary>
+        /// The start of each mesh in the backing file, followed by the arrays in the order of forEachArray
+        /// </summary>
+        struct SpillHeader
+        {
+            std::uint64_t counts[meshArrayCount];
+            glm::vec3 positionOffset;
+            glm::vec3 positionScale;
+            glm::vec2 textureCoordOffset;
+            glm::vec2 textureCoordScale;
+        };
+
+        /// <summary>
+        /// Calls a function with each array of a mesh
+        /// </summary>
+        template<typename MeshType, typename Function>
+        void forEachArray(MeshType& mesh, Function function) {
+            function(mesh.materials);
+            function(mesh.vertexPositions);
+            function(mesh.vertexTextureCoords);
+            function(mesh.vertexNormals);
+            function(mesh.vertexTangents);
+            function(mesh.vertexMaterialIDs);
+            function(mesh.vertexIndices);
+            function(mesh.quantized.vertexPositions);
+            function(mesh.quantized.vertexTextureCoords);
+            function(mesh.quantized.vertexNormals);
+            function(mesh.quantized.vertexTangents);
+            function(mesh.quantized.vertexMaterialIDs8);
+            function(mesh.quantized.vertexMaterialIDs16);
+        }
+
+        /// <summary>
+        /// Blocks while taking more memory would go over the budget. A request is always let
+        /// through when nothing else is held, so a mesh larger than the budget is still built.
+        /// </summary>
+        class MemoryBudget
+        {
+        public:
+            explicit MemoryBudget(std::uint64_t limit) : limit(limit) {}
+
+            void acquire(std::uint64_t bytes) {
+                std::unique_lock<std::mutex> lock(mutex);
+                released.wait(lock, [&]() { return used == 0 || used + bytes <= limit; });
+                used += bytes;
+            }
+
+            // Takes memory that is already in use without waiting, so later requests wait for it instead
+            void add(std::uint64_t bytes) {
+                std::lock_guard<std::mutex> lock(mutex);
+                used += bytes;
+            }
+
+            void release(std::uint64_t bytes) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    used -= bytes;
+                }
+                released.notify_all();
+            }
+
+        private:
+            std::uint64_t limit;
+            std::uint64_t used = 0;
+            std::mutex mutex;
+            std::condition_variable released;
+        };
+
+        /// <summary>
+        /// Estimates the most memory readMeshData uses to build a mesh, from the array lengths in the
+        /// geometry record headers. It adds up the buffers createMeshData allocates for the worst case:
+        /// three corners per polygon vertex, one vertex per corner and one layer value per polygon vertex.
+        /// Allocator overhead, zlib state and the ear clipping temporaries of single polygons are not counted.
+        /// </summary>
+        std::uint64_t estimateBuildBytes(const Document& document, const Node& geometry, const LoadOptions& options) {
+            std::uint64_t controlPoints = getChildArrayLength(document, geometry, "Vertices") / 3;
+            std::uint64_t polygonVertices = getChildArrayLength(document, geometry, "PolygonVertexIndex");
+            std::uint64_t corners = polygonVertices * 3;
+            std::uint64_t vertices = corners;
+
+            // The decoded geometry arrays: double control points, the polygon vertex indices and each loaded
+            // layer as doubles with an index array (the materials are per polygon)
+            std::uint64_t bytes = controlPoints * 3 * sizeof(double) + polygonVertices * sizeof(std::int32_t);
+            if (options.loadNormals)
+                bytes += polygonVertices * (3 * sizeof(double) + sizeof(std::int32_t));
+            if (options.loadTextureCoords)
+                bytes += polygonVertices * (2 * sizeof(double) + sizeof(std::int32_t));
+            if (options.loadMaterials)
+                bytes += polygonVertices * sizeof(std::int32_t);
+
+            // The triangulation (polygon vertex per corner, polygon per triangle) and the transformed points
+            bytes += corners * sizeof(std::uint32_t) + corners / 3 * sizeof(std::uint32_t);
+            bytes += controlPoints * sizeof(glm::vec3);
+            if (options.loadNormals)
+                bytes += polygonVertices * sizeof(glm::vec3);
+
+            // The welder: an open addressing table of up to 4 slots per corner (grid cells with tolerances),
+            // or the two sort arrays and the first corners of the sorted weld, plus the packed vertex keys
+            std::uint64_t tableBytes = options.weldTolerances.position > 0.0f ? corners * 4 * 32 + vertices * sizeof(std::uint32_t) : corners * 4 * 8;
+            std::uint64_t sortBytes = corners * (2 * 16 + sizeof(std::uint32_t)) + vertices * sizeof(std::uint32_t);
+            bytes += std::max(tableBytes, sortBytes) + vertices * VertexKey::maxWords * sizeof(std::uint32_t);
+
+            // The finished mesh, with its float and quantized vertices both alive while quantizing
+            std::uint64_t vertexBytes = sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(glm::vec3) + sizeof(glm::vec4) + sizeof(std::uint32_t);
+            if (options.quantizeVertices)
+                vertexBytes += sizeof(glm::u16vec3) + sizeof(glm::u16vec2) + 2 * sizeof(glm::i16vec2) + sizeof(std::uint16_t);
+            return bytes + corners * sizeof(std::uint32_t) + vertices * vertexBytes;
+        }
+
+        std::string getTemporaryBackingPath() {
+            std::random_device random;
+            char name[48];
+            std::snprintf(name, sizeof(name), "%08x%08x.fbxspill", (unsigned)random(), (unsigned)random());
+            return (std::filesystem::temp_directory_path() / name).string();
+        }
+    }
+
+    std::uint64_t getMeshMemorySize(const Mesh& mesh) {
+        std::uint64_t size = 0;
+        forEachArray(mesh, [&](const auto& values) {
+            size += values.size() * sizeof(values[0]);
+        });
+        return size;
+    }
+
+    SpilledScene::SpilledScene(const char* filename, std::uint64_t memoryBudget, const LoadOptions& options, const std::string& backingFile)
+        : memoryBudget(memoryBudget), backingPath(backingFile.empty() ? getTemporaryBackingPath() : backingFile) {
+
+        std::ofstream backing(backingPath, std::ios::binary | std::ios::trunc);
+        if (!backing) {
+            throw std::runtime_error("Failed to create the mesh backing file.");
+        }
+
+        try {
+            // The materials and lights are created while walking the nodes, the meshes only get a slot.
+            // Only binary geometry is deferred, an ASCII document arrives with every array decoded.
+            SceneGraph graph = buildSceneGraph(readDocument(filename, true));
+            std::vector<const SceneNode*> meshNodes;
+            getChildren(graph.nodes[0], graph, sceneData, meshNodes, options);
+
+            meshes.resize(meshNodes.size());
+            MemoryBudget buildBudget(memoryBudget);
+            std::mutex backingMutex;
+            ThreadPool::shared().parallelFor(meshNodes.size(), [&](size_t i) {
+                // Wait for enough of the budget to build the mesh
+                const SceneNode& node = *meshNodes[i];
+                std::uint64_t buildBytes = estimateBuildBytes(graph.document, *node.geometry, options);
+                buildBudget.acquire(buildBytes);
+
+                try {
+                    std::vector<uint32_t> materialIndices = std::move(sceneData.meshes[i].materials);
+                    Mesh mesh = readMeshData(graph, *node.geometry, materialIndices, getMeshTransform(node, options), options);
+                    mesh.materials = std::move(materialIndices);
+
+                    // The finished mesh is measured, if it outgrew the estimate the difference is held until it is freed
+                    std::uint64_t meshBytes = getMeshMemorySize(mesh);
+                    if (meshBytes > buildBytes) {
+                        buildBudget.add(meshBytes - buildBytes);
+                        buildBytes = meshBytes;
+                    }
+
+                    SpillHeader header{};
+                    int array = 0;
+                    forEachArray(mesh, [&](const auto& values) {
+                        header.counts[array++] = values.size();
+                    });
+                    header.positionOffset = mesh.quantized.positionOffset;
+                    header.positionScale = mesh.quantized.positionScale;
+                    header.textureCoordOffset = mesh.quantized.textureCoordOffset;
+                    header.textureCoordScale = mesh.quantized.textureCoordScale;
+
+                    // Append the mesh to the backing file, the mesh is freed when it goes out of scope
+                    std::lock_guard<std::mutex> lock(backingMutex);
+                    meshes[i].offset = (std::uint64_t)backing.tellp();
+                    backing.write((const char*)&header, sizeof(header));
+                    forEachArray(mesh, [&](const auto& values) {
+                        backing.write((const char*)values.data(), (std::streamsize)(values.size() * sizeof(values[0])));
+                    });
+                    if (!backing) {
+                        throw std::runtime_error("Failed to write the mesh backing file.");
+                    }
+                    meshes[i].size = (std::uint64_t)backing.tellp() - meshes[i].offset;
+                }
+                catch (...) {
+                    buildBudget.release(buildBytes);
+                    throw;
+                }
+                buildBudget.release(buildBytes);
+            });
+
+            backing.close();
+            if (!backing) {
+                throw std::runtime_error("Failed to write the mesh backing file.");
+            }
+        }
+        catch (...) {
+            backing.close();
+            std::error_code error;
+            std::filesystem::remove(backingPath, error);
+            throw;
+        }
+
+        // Only the handles are kept
+        sceneData.meshes.clear();
+        sceneData.meshes.shrink_to_fit();
+
+        residentMeshes.resize(meshes.size());
+        recentlyUsedPositions.resize(meshes.size(), recentlyUsed.end());
+    }
+
+    SpilledScene::~SpilledScene() {
+        std::error_code error;
+        std::filesystem::remove(backingPath, error);
+    }
+
+    std::shared_ptr<const Mesh> SpilledScene::getMesh(size_t meshIndex) {
+        if (meshIndex >= meshes.size()) {
+            throw std::out_of_range("Mesh index out of range.");
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(residentMutex);
+            if (residentMeshes[meshIndex]) {
+                recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, recentlyUsedPositions[meshIndex]);
+                return residentMeshes[meshIndex];
+            }
+        }
+
+        // Read without holding the lock so other meshes can be read at the same time
+        std::shared_ptr<const Mesh> mesh = std::make_shared<const Mesh>(readMesh(meshIndex));
+        std::uint64_t meshBytes = getMeshMemorySize(*mesh);
+
+        std::lock_guard<std::mutex> lock(residentMutex);
+        if (residentMeshes[meshIndex]) {
+            // Another thread read it first
+            recentlyUsed.splice(recentlyUsed.begin(), recentlyUsed, recentlyUsedPositions[meshIndex]);
+            return residentMeshes[meshIndex];
+        }
+
+        // Drop the least recently used meshes until the new one fits
+        while (!recentlyUsed.empty() && residentBytes + meshBytes > memoryBudget) {
+            size_t evicted = recentlyUsed.back();
+            recentlyUsed.pop_back();
+            residentBytes -= getMeshMemorySize(*residentMeshes[evicted]);
+            residentMeshes[evicted].reset();
+            recentlyUsedPositions[evicted] = recentlyUsed.end();
+        }
+
+        residentMeshes[meshIndex] = mesh;
+        recentlyUsed.push_front(meshIndex);
+        recentlyUsedPositions[meshIndex] = recentlyUsed.begin();
+        residentBytes += meshBytes;
+        return mesh;
+    }
+
+    std::uint64_t SpilledScene::getResidentBytes() {
+        std::lock_guard<std::mutex> lock(residentMutex);
+        return residentBytes;
+    }
+
+    Mesh SpilledScene::readMesh(size_t meshIndex) const {
+        const SpilledMesh& handle = meshes[meshIndex];
+
+        // Each read opens the file itself so reads on different threads do not share a position
+        std::ifstream backing(backingPath, std::ios::binary);
+        backing.seekg((std::streamoff)handle.offset);
+
+        SpillHeader header;
+        backing.read((char*)&header, sizeof(header));
+
+        // Read the arrays straight into the mesh, checking they stay within the mesh
+        Mesh mesh;
+        std::uint64_t remaining = handle.size - std::min<std::uint64_t>(handle.size, sizeof(header));
+        int array = 0;
+        forEachArray(mesh, [&](auto& values) {
+            std::uint64_t count = header.counts[array++];
+            if (count > remaining / sizeof(values[0])) {
+                throw std::runtime_error("Invalid spilled mesh.");
+            }
+            values.resize((size_t)count);
+            backing.read((char*)values.data(), (std::streamsize)(count * sizeof(values[0])));
+            remaining -= count * sizeof(values[0]);
+        });
+        if (!backing) {
+            throw std::runtime_error("Failed to read a spilled mesh.");
+        }
+
+        mesh.quantized.positionOffset = header.positionOffset;
+        mesh.quantized.positionScale = header.positionScale;
+        mesh.quantized.textureCoordOffset = header.textureCoordOffset;
+        mesh.quantized.textureCoordScale = header.textureCoordScale;
+        return mesh;
+    }
+}
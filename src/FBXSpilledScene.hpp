@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "FBXFileLoader.hpp"
+
+namespace fbx {
+	/// <summary>
+	/// The location of a mesh written to the backing file of a spilled scene
+	/// </summary>
+	struct SpilledMesh
+	{
+		std::uint64_t offset = 0;
+		std::uint64_t size = 0;
+	};
+
+	/// <summary>
+	/// A scene loaded out of core. Each mesh is written to a backing file as soon as it is built and
+	/// freed, only its handle is kept. Meshes are read back on access and kept in memory until the
+	/// memory budget is reached, then the least recently used ones are dropped.
+	/// The budget also limits how many meshes are built at once while loading. The memory to build a mesh
+	/// is a heuristic worst case estimate from the array lengths in the geometry record headers, checked
+	/// against the size of the finished mesh. It does not count allocator overhead, so the budget is
+	/// approximate, and a single mesh larger than the budget is still built.
+	/// Only binary files are loaded out of core. Their geometry records are read when each mesh is built,
+	/// but an ASCII file is parsed with all its geometry arrays in memory before the first mesh is built,
+	/// so the memory used while loading one still grows with the size of the scene.
+	/// </summary>
+	class SpilledScene
+	{
+	public:
+		/// <summary>
+		/// Loads an FBX file, spilling every mesh to the backing file
+		/// </summary>
+		/// <param name="filename">The .fbx file path</param>
+		/// <param name="memoryBudget">The most memory in bytes used for meshes while loading and for meshes read back</param>
+		/// <param name="options">Which parts of the file to load</param>
+		/// <param name="backingFile">The file the meshes are written to, a new file in the temporary directory when empty</param>
+		SpilledScene(const char* filename, std::uint64_t memoryBudget, const LoadOptions& options = LoadOptions(), const std::string& backingFile = std::string());
+
+		/// <summary>
+		/// Removes the backing file
+		/// </summary>
+		~SpilledScene();
+
+		SpilledScene(const SpilledScene&) = delete;
+		SpilledScene& operator=(const SpilledScene&) = delete;
+
+		size_t getMeshCount() const { return meshes.size(); }
+		const SpilledMesh& getMeshHandle(size_t meshIndex) const { return meshes.at(meshIndex); }
+
+		/// <summary>
+		/// Gets the scene without its meshes (the materials, texture sets and lights)
+		/// </summary>
+		const Scene& getSceneData() const { return sceneData; }
+
+		/// <summary>
+		/// Gets a mesh, reading it back from the backing file if it is not in memory.
+		/// Meshes can be requested from multiple threads at once. A mesh dropped from memory
+		/// stays alive for as long as the caller holds on to it.
+		/// </summary>
+		/// <param name="meshIndex">The index of the mesh</param>
+		/// <returns>The mesh data</returns>
+		std::shared_ptr<const Mesh> getMesh(size_t meshIndex);
+
+		/// <summary>
+		/// Gets the memory in bytes used by the meshes currently kept in memory
+		/// </summary>
+		std::uint64_t getResidentBytes();
+
+	private:
+		Mesh readMesh(size_t meshIndex) const;
+
+		std::uint64_t memoryBudget;
+		std::string backingPath;
+		Scene sceneData;
+		std::vector<SpilledMesh> meshes;
+
+		// The meshes kept in memory, most recently used first
+		std::mutex residentMutex;
+		std::vector<std::shared_ptr<const Mesh>> residentMeshes;
+		std::list<size_t> recentlyUsed;
+		std::vector<std::list<size_t>::iterator> recentlyUsedPositions;
+		std::uint64_t residentBytes = 0;
+	};
+
+	/// <summary>
+	/// Gets the memory in bytes used by the arrays of a mesh
+	/// </summary>
+	/// <param name="mesh">The mesh</param>
+	/// <returns>The size of the mesh arrays</returns>
+	std::uint64_t getMeshMemorySize(const Mesh& mesh);
+}
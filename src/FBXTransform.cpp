@@ -0,0 +1,158 @@
+#include "FBXTransform.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FBX_TRANSFORM_SSE 1
+#endif
+
+// The AVX2 kernel is compiled for the target attribute (or by MSVC, which allows the intrinsics anywhere)
+// and only called after checking the CPU at runtime
+#if defined(FBX_TRANSFORM_SSE) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#include <immintrin.h>
+#define FBX_TRANSFORM_AVX2 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FBX_AVX2_TARGET
+#else
+#define FBX_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace fbx {
+
+    namespace {
+        /// <summary>
+        /// Transforms points one at a time, written out the way glm evaluates mat4 * vec4
+        /// </summary>
+        void transformScalar(const glm::mat4& m, const float* inX, const float* inY, const float* inZ,
+            float* outX, float* outY, float* outZ, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                float x = inX[i];
+                float y = inY[i];
+                float z = inZ[i];
+                outX[i] = (m[0][0] * x + m[1][0] * y) + (m[2][0] * z + m[3][0]);
+                outY[i] = (m[0][1] * x + m[1][1] * y) + (m[2][1] * z + m[3][1]);
+                outZ[i] = (m[0][2] * x + m[1][2] * y) + (m[2][2] * z + m[3][2]);
+            }
+        }
+
+#ifdef FBX_TRANSFORM_SSE
+        /// <summary>
+        /// Transforms 4 points at a time, returns where the scalar tail starts
+        /// </summary>
+        size_t transformSSE(const glm::mat4& m, const float* inX, const float* inY, const float* inZ,
+            float* outX, float* outY, float* outZ, size_t count) {
+            __m128 column[4][3];
+            for (int c = 0; c < 4; c++) {
+                for (int r = 0; r < 3; r++) {
+                    column[c][r] = _mm_set1_ps(m[c][r]);
+                }
+            }
+
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4) {
+                __m128 x = _mm_loadu_ps(inX + i);
+                __m128 y = _mm_loadu_ps(inY + i);
+                __m128 z = _mm_loadu_ps(inZ + i);
+                float* out[3] = { outX, outY, outZ };
+                for (int r = 0; r < 3; r++) {
+                    __m128 xy = _mm_add_ps(_mm_mul_ps(column[0][r], x), _mm_mul_ps(column[1][r], y));
+                    __m128 zw = _mm_add_ps(_mm_mul_ps(column[2][r], z), column[3][r]);
+                    _mm_storeu_ps(out[r] + i, _mm_add_ps(xy, zw));
+                }
+            }
+            return i;
+        }
+#endif
+
+#ifdef FBX_TRANSFORM_AVX2
+        /// <summary>
+        /// Transforms 8 points at a time, returns where the scalar tail starts.
+        /// Only AVX2 is enabled, not FMA, so the multiplies and adds are never fused and round like glm's.
+        /// </summary>
+        FBX_AVX2_TARGET size_t transformAVX2(const glm::mat4& m, const float* inX, const float* inY, const float* inZ,
+            float* outX, float* outY, float* outZ, size_t count) {
+            __m256 column[4][3];
+            for (int c = 0; c < 4; c++) {
+                for (int r = 0; r < 3; r++) {
+                    column[c][r] = _mm256_set1_ps(m[c][r]);
+                }
+            }
+
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8) {
+                __m256 x = _mm256_loadu_ps(inX + i);
+                __m256 y = _mm256_loadu_ps(inY + i);
+                __m256 z = _mm256_loadu_ps(inZ + i);
+                float* out[3] = { outX, outY, outZ };
+                for (int r = 0; r < 3; r++) {
+                    __m256 xy = _mm256_add_ps(_mm256_mul_ps(column[0][r], x), _mm256_mul_ps(column[1][r], y));
+                    __m256 zw = _mm256_add_ps(_mm256_mul_ps(column[2][r], z), column[3][r]);
+                    _mm256_storeu_ps(out[r] + i, _mm256_add_ps(xy, zw));
+                }
+            }
+            return i;
+        }
+
+        bool cpuHasAVX2() {
+#ifdef _MSC_VER
+            // AVX2 needs the CPU flag and the OS saving the YMM registers
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) {
+                return false;
+            }
+            __cpuid(info, 1);
+            bool osSavesYMM = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+            __cpuidex(info, 7, 0);
+            return osSavesYMM && (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+    }
+
+    TransformKernel getTransformKernel() {
+        static const TransformKernel kernel = []() {
+#ifdef FBX_TRANSFORM_AVX2
+            if (cpuHasAVX2()) {
+                return TransformKernel::AVX2;
+            }
+#endif
+#ifdef FBX_TRANSFORM_SSE
+            return TransformKernel::SSE;
+#else
+            return TransformKernel::Scalar;
+#endif
+        }();
+        return kernel;
+    }
+
+    void transformPoints(const glm::mat4& matrix, const float* inX, const float* inY, const float* inZ,
+        float* outX, float* outY, float* outZ, size_t count, TransformKernel kernel) {
+        size_t done = 0;
+        switch (kernel) {
+#ifdef FBX_TRANSFORM_AVX2
+        case TransformKernel::AVX2:
+            done = transformAVX2(matrix, inX, inY, inZ, outX, outY, outZ, count);
+            break;
+#endif
+#ifdef FBX_TRANSFORM_SSE
+        case TransformKernel::SSE:
+            done = transformSSE(matrix, inX, inY, inZ, outX, outY, outZ, count);
+            break;
+#endif
+        default:
+            break;
+        }
+
+        // Scalar transform for the tail (or all of it without SIMD)
+        transformScalar(matrix, inX, inY, inZ, outX, outY, outZ, done, count);
+    }
+
+    void transformPoints(const glm::mat4& matrix, PointArrays& points) {
+        transformPoints(matrix, points.x.data(), points.y.data(), points.z.data(),
+            points.x.data(), points.y.data(), points.z.data(), points.size());
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+
+#include <glm.hpp>
+
+namespace fbx {
+	/// <summary>
+	/// The ways transformPoints can run, from slowest to fastest
+	/// </summary>
+	enum class TransformKernel { Scalar, SSE, AVX2 };
+
+	/// <summary>
+	/// Points stored as separate x, y and z arrays
+	/// </summary>
+	struct PointArrays
+	{
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+
+		size_t size() const { return x.size(); }
+		glm::vec3 operator[](size_t i) const { return glm::vec3(x[i], y[i], z[i]); }
+
+		/// <summary>
+		/// Fills the arrays from interleaved xyz triples, narrowing them to floats
+		/// </summary>
+		/// <param name="values">The point components, 3 per point</param>
+		/// <param name="count">The number of points</param>
+		template<typename Values>
+		void assign(const Values& values, size_t count) {
+			x.resize(count);
+			y.resize(count);
+			z.resize(count);
+			for (size_t i = 0; i < count; i++) {
+				x[i] = (float)values[i * 3];
+				y[i] = (float)values[i * 3 + 1];
+				z[i] = (float)values[i * 3 + 2];
+			}
+		}
+	};
+
+	/// <summary>
+	/// Gets the fastest kernel the CPU running the program supports, detected once on first use
+	/// </summary>
+	TransformKernel getTransformKernel();
+
+	/// <summary>
+	/// Transforms points by a matrix with w = 1 and keeps x, y and z, in batches of 8 with AVX2 or 4 with SSE.
+	/// Every kernel adds the matrix columns in the same order as glm's mat4 * vec4, so the results are bit
+	/// identical to transforming the points one at a time with glm. The input and output arrays may be the same.
+	/// </summary>
+	/// <param name="matrix">The transform</param>
+	/// <param name="inX">The x components of the points</param>
+	/// <param name="inY">The y components of the points</param>
+	/// <param name="inZ">The z components of the points</param>
+	/// <param name="outX">The transformed x components</param>
+	/// <param name="outY">The transformed y components</param>
+	/// <param name="outZ">The transformed z components</param>
+	/// <param name="count">The number of points</param>
+	/// <param name="kernel">The kernel to use, it must be supported by the CPU</param>
+	void transformPoints(const glm::mat4& matrix, const float* inX, const float* inY, const float* inZ,
+		float* outX, float* outY, float* outZ, size_t count, TransformKernel kernel = getTransformKernel());
+
+	/// <summary>
+	/// Transforms point arrays in place with the fastest supported kernel
+	/// </summary>
+	/// <param name="matrix">The transform</param>
+	/// <param name="points">The points</param>
+	void transformPoints(const glm::mat4& matrix, PointArrays& points);
+}
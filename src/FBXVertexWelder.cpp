@@ -0,0 +1,440 @@
+#include "FBXVertexWelder.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <xmmintrin.h>
+#define FBX_WELDER_SSE 1
+#endif
+
+namespace fbx {
+
+    namespace {
+        const std::uint32_t emptySlot = 0xffffffff;
+
+        std::uint32_t getBits(float value) {
+            // Adding zero turns -0 into 0 so corners that compare equal as floats get the same key
+            value += 0.0f;
+            std::uint32_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+
+        std::uint64_t hashWords(const std::uint32_t* words, int count) {
+            std::uint64_t hash = 0x9e3779b97f4a7c15ull;
+            for (int i = 0; i < count; i++) {
+                hash = (hash ^ words[i]) * 0xff51afd7ed558ccdull;
+                hash ^= hash >> 29;
+            }
+            return hash;
+        }
+
+        float getFloat(std::uint32_t bits) {
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        // Cells beyond this coordinate (and NaNs) share the outermost cell
+        const double maxCellCoordinate = 1e15;
+
+        std::int64_t getCellCoordinate(double value) {
+            if (!(value > -maxCellCoordinate)) {
+                return (std::int64_t)-maxCellCoordinate;
+            }
+            if (!(value < maxCellCoordinate)) {
+                return (std::int64_t)maxCellCoordinate;
+            }
+            return (std::int64_t)std::floor(value);
+        }
+
+        std::uint64_t hashCell(std::int64_t x, std::int64_t y, std::int64_t z) {
+            std::uint64_t hash = (std::uint64_t)x * 0x9e3779b97f4a7c15ull;
+            hash = (hash ^ (std::uint64_t)y) * 0xff51afd7ed558ccdull;
+            hash = (hash ^ (std::uint64_t)z) * 0xc4ceb9fe1a85ec53ull;
+            return hash ^ (hash >> 32);
+        }
+
+        // The fewest corners given to each task of the sorted weld
+        const size_t minSortBlock = 1 << 16;
+
+        size_t getBlockStart(size_t count, size_t blockCount, size_t block) {
+            return count * block / blockCount;
+        }
+    }
+
+    VertexKey makeVertexKey(const glm::vec3& position, const glm::vec3* normal, const glm::vec2* textureCoord, const std::uint32_t* materialID) {
+        VertexKey key;
+        key.words[key.wordCount++] = getBits(position.x);
+        key.words[key.wordCount++] = getBits(position.y);
+        key.words[key.wordCount++] = getBits(position.z);
+        if (normal != nullptr) {
+            key.normalWord = (std::int8_t)key.wordCount;
+            key.words[key.wordCount++] = getBits(normal->x);
+            key.words[key.wordCount++] = getBits(normal->y);
+            key.words[key.wordCount++] = getBits(normal->z);
+        }
+        if (textureCoord != nullptr) {
+            key.textureCoordWord = (std::int8_t)key.wordCount;
+            key.words[key.wordCount++] = getBits(textureCoord->x);
+            key.words[key.wordCount++] = getBits(textureCoord->y);
+        }
+        if (materialID != nullptr) {
+            key.materialWord = (std::int8_t)key.wordCount;
+            key.words[key.wordCount++] = *materialID;
+        }
+        key.hash = (std::uint32_t)(hashWords(key.words, key.wordCount) >> 32);
+        return key;
+    }
+
+    bool VertexWelder::useSortedWeld(size_t cornerCount, const WeldTolerances& tolerances) {
+        return tolerances.position <= 0.0f && cornerCount >= sortedWeldCornerCount && ThreadPool::shared().size() > 1;
+    }
+
+    void VertexWelder::begin(size_t cornerCount, const WeldTolerances& weldTolerances) {
+        // At most half full, so probe sequences stay short
+        size_t capacity = 16;
+        while (capacity < cornerCount * 2) {
+            capacity *= 2;
+        }
+
+        tolerances = weldTolerances;
+        useGrid = tolerances.position > 0.0f;
+        if (useGrid) {
+            // A position and everything within the tolerance of it overlap at most 2 cells on each axis
+            cellSize = 2.0 * tolerances.position;
+            minNormalCosine = (float)std::cos(std::min(tolerances.normalAngle, 180.0f) * 3.14159265358979323846 / 180.0);
+            cellMask = capacity - 1;
+            cells.assign(capacity, Cell{ 0, 0, 0, emptySlot });
+            nextInCell.clear();
+        }
+        else {
+            mask = capacity - 1;
+            table.assign(capacity, Slot{ 0, emptySlot });
+        }
+
+        vertexKeys.clear();
+        keyWords = 0;
+        vertexCount = 0;
+    }
+
+    void VertexWelder::prefetch(const VertexKey& key) const {
+        // The grid cells are only known once the position is decoded
+        if (useGrid) {
+            return;
+        }
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(&table[key.hash & mask]);
+#elif defined(FBX_WELDER_SSE)
+        _mm_prefetch((const char*)&table[key.hash & mask], _MM_HINT_T0);
+#endif
+    }
+
+    std::uint32_t VertexWelder::add(const VertexKey& key, bool& isNewVertex) {
+        keyWords = key.wordCount;
+        if (useGrid) {
+            return addToGrid(key, isNewVertex);
+        }
+
+        // Probe until the key or an empty slot is found
+        size_t position = key.hash & mask;
+        while (true) {
+            Slot& slot = table[position];
+            if (slot.vertex == emptySlot) {
+                // New vertex, its key is kept with the others in vertex order since nearby corners mostly use recent vertices
+                slot.hash = key.hash;
+                slot.vertex = (std::uint32_t)vertexCount++;
+                vertexKeys.insert(vertexKeys.end(), key.words, key.words + key.wordCount);
+                isNewVertex = true;
+                return slot.vertex;
+            }
+            if (slot.hash == key.hash && std::memcmp(key.words, &vertexKeys[(size_t)slot.vertex * keyWords], keyWords * sizeof(std::uint32_t)) == 0) {
+                // Identical to an earlier vertex
+                isNewVertex = false;
+                return slot.vertex;
+            }
+            position = (position + 1) & mask;
+        }
+    }
+
+    std::uint32_t VertexWelder::addToGrid(const VertexKey& key, bool& isNewVertex) {
+        glm::dvec3 position(getFloat(key.words[0]), getFloat(key.words[1]), getFloat(key.words[2]));
+        double tolerance = tolerances.position;
+
+        // Look through the cells overlapping the tolerance around the position for the lowest numbered vertex in range
+        std::int64_t first[3];
+        std::int64_t last[3];
+        for (int axis = 0; axis < 3; axis++) {
+            first[axis] = getCellCoordinate((position[axis] - tolerance) / cellSize);
+            last[axis] = getCellCoordinate((position[axis] + tolerance) / cellSize);
+        }
+
+        std::uint32_t match = emptySlot;
+        for (std::int64_t x = first[0]; x <= last[0]; x++) {
+            for (std::int64_t y = first[1]; y <= last[1]; y++) {
+                for (std::int64_t z = first[2]; z <= last[2]; z++) {
+                    const Cell* cell = findCell(x, y, z, false);
+                    if (cell == nullptr) {
+                        continue;
+                    }
+                    for (std::uint32_t vertex = cell->firstVertex; vertex != emptySlot; vertex = nextInCell[vertex]) {
+                        if (vertex < match && isInTolerance(key, vertex)) {
+                            match = vertex;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (match != emptySlot) {
+            isNewVertex = false;
+            return match;
+        }
+
+        // New vertex, added to the list of the cell holding its position
+        std::uint32_t vertex = (std::uint32_t)vertexCount++;
+        vertexKeys.insert(vertexKeys.end(), key.words, key.words + key.wordCount);
+        Cell* cell = findCell(getCellCoordinate(position.x / cellSize), getCellCoordinate(position.y / cellSize), getCellCoordinate(position.z / cellSize), true);
+        nextInCell.emplace_back(cell->firstVertex);
+        cell->firstVertex = vertex;
+        isNewVertex = true;
+        return vertex;
+    }
+
+    VertexWelder::Cell* VertexWelder::findCell(std::int64_t x, std::int64_t y, std::int64_t z, bool create) {
+        // There are never more cells than vertices so the table never fills up
+        size_t position = hashCell(x, y, z) & cellMask;
+        while (true) {
+            Cell& cell = cells[position];
+            if (cell.firstVertex == emptySlot) {
+                if (!create) {
+                    return nullptr;
+                }
+                cell.x = x;
+                cell.y = y;
+                cell.z = z;
+                return &cell;
+            }
+            if (cell.x == x && cell.y == y && cell.z == z) {
+                return &cell;
+            }
+            position = (position + 1) & cellMask;
+        }
+    }
+
+    bool VertexWelder::isInTolerance(const VertexKey& key, std::uint32_t vertex) const {
+        const std::uint32_t* words = &vertexKeys[(size_t)vertex * keyWords];
+
+        if (key.materialWord >= 0 && key.words[key.materialWord] != words[key.materialWord]) {
+            return false;
+        }
+
+        float distanceSquared = 0.0f;
+        for (int i = 0; i < 3; i++) {
+            float difference = getFloat(key.words[i]) - getFloat(words[i]);
+            distanceSquared += difference * difference;
+        }
+        if (!(distanceSquared <= tolerances.position * tolerances.position)) {
+            return false;
+        }
+
+        if (key.normalWord >= 0) {
+            const std::uint32_t* normalWords = key.words + key.normalWord;
+            const std::uint32_t* otherWords = words + key.normalWord;
+            if (tolerances.normalAngle <= 0.0f) {
+                if (std::memcmp(normalWords, otherWords, 3 * sizeof(std::uint32_t)) != 0) {
+                    return false;
+                }
+            }
+            else {
+                glm::vec3 normal(getFloat(normalWords[0]), getFloat(normalWords[1]), getFloat(normalWords[2]));
+                glm::vec3 other(getFloat(otherWords[0]), getFloat(otherWords[1]), getFloat(otherWords[2]));
+                float lengths = std::sqrt(glm::dot(normal, normal) * glm::dot(other, other));
+                if (!(glm::dot(normal, other) >= minNormalCosine * lengths)) {
+                    return false;
+                }
+            }
+        }
+
+        if (key.textureCoordWord >= 0) {
+            const std::uint32_t* textureCoordWords = key.words + key.textureCoordWord;
+            const std::uint32_t* otherWords = words + key.textureCoordWord;
+            if (tolerances.textureCoord <= 0.0f) {
+                if (std::memcmp(textureCoordWords, otherWords, 2 * sizeof(std::uint32_t)) != 0) {
+                    return false;
+                }
+            }
+            else {
+                for (int i = 0; i < 2; i++) {
+                    if (!(std::fabs(getFloat(textureCoordWords[i]) - getFloat(otherWords[i])) <= tolerances.textureCoord)) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void VertexWelder::weldSorted(size_t cornerCount, const std::function<VertexKey(size_t)>& getKey, std::vector<std::uint32_t>& outIndices,
+        std::vector<std::uint32_t>& outVertexSources) {
+        ThreadPool& pool = ThreadPool::shared();
+        size_t blockCount = std::max<size_t>(1, std::min<size_t>(cornerCount / minSortBlock, (pool.size() + 1) * 4));
+
+        // Hash the key of every corner
+        sortEntries.resize(cornerCount);
+        sortScratch.resize(cornerCount);
+        pool.parallelFor(blockCount, [&](size_t block) {
+            size_t end = getBlockStart(cornerCount, blockCount, block + 1);
+            for (size_t i = getBlockStart(cornerCount, blockCount, block); i < end; i++) {
+                VertexKey key = getKey(i);
+                sortEntries[i] = SortEntry{ hashWords(key.words, key.wordCount), (std::uint32_t)i };
+            }
+        });
+
+        // Radix sort the corners on their hash a byte at a time. Each pass is stable, so corners with the same
+        // hash stay in corner order. Every block counts its digits, then scatters into its own share of each digit.
+        std::vector<std::array<size_t, 256>> digitCounts(blockCount);
+        for (int shift = 0; shift < 64; shift += 8) {
+            pool.parallelFor(blockCount, [&](size_t block) {
+                std::array<size_t, 256>& counts = digitCounts[block];
+                counts.fill(0);
+                size_t end = getBlockStart(cornerCount, blockCount, block + 1);
+                for (size_t i = getBlockStart(cornerCount, blockCount, block); i < end; i++) {
+                    counts[(sortEntries[i].hash >> shift) & 0xff]++;
+                }
+            });
+
+            // Nothing moves when every hash has the same digit
+            size_t firstDigit = cornerCount == 0 ? 0 : (sortEntries[0].hash >> shift) & 0xff;
+            size_t firstDigitCount = 0;
+            for (size_t block = 0; block < blockCount; block++) {
+                firstDigitCount += digitCounts[block][firstDigit];
+            }
+            if (firstDigitCount == cornerCount) {
+                continue;
+            }
+
+            size_t offset = 0;
+            for (size_t digit = 0; digit < 256; digit++) {
+                for (size_t block = 0; block < blockCount; block++) {
+                    size_t count = digitCounts[block][digit];
+                    digitCounts[block][digit] = offset;
+                    offset += count;
+                }
+            }
+
+            pool.parallelFor(blockCount, [&](size_t block) {
+                std::array<size_t, 256>& offsets = digitCounts[block];
+                size_t end = getBlockStart(cornerCount, blockCount, block + 1);
+                for (size_t i = getBlockStart(cornerCount, blockCount, block); i < end; i++) {
+                    sortScratch[offsets[(sortEntries[i].hash >> shift) & 0xff]++] = sortEntries[i];
+                }
+            });
+            sortEntries.swap(sortScratch);
+        }
+
+        // Find the first corner with the same key as each corner. Blocks are moved to the start of a run of
+        // equal hashes. Within a run the corners are in order, and hash collisions are told apart by the full keys.
+        firstCorners.resize(cornerCount);
+        pool.parallelFor(blockCount, [&](size_t block) {
+            auto findRunStart = [&](size_t i) {
+                while (i > 0 && i < cornerCount && sortEntries[i].hash == sortEntries[i - 1].hash) {
+                    i++;
+                }
+                return i;
+            };
+            size_t start = findRunStart(getBlockStart(cornerCount, blockCount, block));
+            size_t end = findRunStart(getBlockStart(cornerCount, blockCount, block + 1));
+
+            std::vector<std::pair<VertexKey, std::uint32_t>> runKeys;
+            for (size_t runStart = start; runStart < end;) {
+                size_t runEnd = runStart + 1;
+                while (runEnd < cornerCount && sortEntries[runEnd].hash == sortEntries[runStart].hash) {
+                    runEnd++;
+                }
+
+                if (runEnd - runStart == 1) {
+                    firstCorners[sortEntries[runStart].corner] = sortEntries[runStart].corner;
+                }
+                else {
+                    runKeys.clear();
+                    for (size_t i = runStart; i < runEnd; i++) {
+                        std::uint32_t corner = sortEntries[i].corner;
+                        VertexKey key = getKey(corner);
+                        auto match = std::find_if(runKeys.begin(), runKeys.end(), [&](const std::pair<VertexKey, std::uint32_t>& runKey) {
+                            return std::memcmp(runKey.first.words, key.words, key.wordCount * sizeof(std::uint32_t)) == 0;
+                        });
+                        if (match != runKeys.end()) {
+                            firstCorners[corner] = match->second;
+                        }
+                        else {
+                            firstCorners[corner] = corner;
+                            runKeys.emplace_back(key, corner);
+                        }
+                    }
+                }
+                runStart = runEnd;
+            }
+        });
+
+        // Number the vertices in the order of their first corners, counting them per block of corners first
+        std::vector<size_t> blockVertices(blockCount + 1, 0);
+        pool.parallelFor(blockCount, [&](size_t block) {
+            size_t count = 0;
+            size_t end = getBlockStart(cornerCount, blockCount, block + 1);
+            for (size_t i = getBlockStart(cornerCount, blockCount, block); i < end; i++) {
+                count += firstCorners[i] == i;
+            }
+            blockVertices[block + 1] = count;
+        });
+        for (size_t block = 0; block < blockCount; block++) {
+            blockVertices[block + 1] += blockVertices[block];
+        }
+        vertexCount = blockVertices[blockCount];
+
+        outIndices.resize(cornerCount);
+        outVertexSources.resize(vertexCount);
+        pool.parallelFor(blockCount, [&](size_t block) {
+            std::uint32_t vertex = (std::uint32_t)blockVertices[block];
+            size_t end = getBlockStart(cornerCount, blockCount, block + 1);
+            for (size_t i = getBlockStart(cornerCount, blockCount, block); i < end; i++) {
+                if (firstCorners[i] == i) {
+                    outVertexSources[vertex] = (std::uint32_t)i;
+                    outIndices[i] = vertex++;
+                }
+            }
+        });
+
+        // The other corners take the vertex of their first corner, which is always numbered by now
+        pool.parallelFor(blockCount, [&](size_t block) {
+            size_t end = getBlockStart(cornerCount, blockCount, block + 1);
+            for (size_t i = getBlockStart(cornerCount, blockCount, block); i < end; i++) {
+                if (firstCorners[i] != i) {
+                    outIndices[i] = outIndices[firstCorners[i]];
+                }
+            }
+        });
+    }
+
+    void VertexWelder::clear() {
+        table.clear();
+        table.shrink_to_fit();
+        cells.clear();
+        cells.shrink_to_fit();
+        nextInCell.clear();
+        nextInCell.shrink_to_fit();
+        vertexKeys.clear();
+        vertexKeys.shrink_to_fit();
+        sortEntries.clear();
+        sortEntries.shrink_to_fit();
+        sortScratch.clear();
+        sortScratch.shrink_to_fit();
+        firstCorners.clear();
+        firstCorners.shrink_to_fit();
+    }
+}
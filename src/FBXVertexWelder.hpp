@@ -0,0 +1,172 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <glm.hpp>
+
+namespace fbx {
+	/// <summary>
+	/// How far apart the attributes of corners may be for them to be welded into one vertex.
+	/// Tolerant welding is used when the position tolerance is above 0, the other tolerances only apply then.
+	/// A tolerance of 0 means the attribute must match exactly. Material IDs always have to match.
+	/// </summary>
+	struct WeldTolerances
+	{
+		float position = 0.0f;			// The largest distance between welded positions
+		float normalAngle = 0.0f;		// The largest angle in degrees between welded normals
+		float textureCoord = 0.0f;		// The largest difference in each texture coordinate component
+	};
+
+	/// <summary>
+	/// The bit patterns of the loaded attributes of a corner (with -0 counted as 0) and their hash
+	/// </summary>
+	struct VertexKey
+	{
+		// Position, normal, texture coordinate and material ID
+		static const int maxWords = 3 + 3 + 2 + 1;
+
+		std::uint32_t words[maxWords];
+		int wordCount = 0;
+		std::uint32_t hash = 0;
+
+		// Where each attribute starts in the words, -1 when it is not loaded. The position always starts at 0.
+		std::int8_t normalWord = -1;
+		std::int8_t textureCoordWord = -1;
+		std::int8_t materialWord = -1;
+	};
+
+	/// <summary>
+	/// Makes the key of a corner
+	/// </summary>
+	/// <param name="position">The corner position</param>
+	/// <param name="normal">The corner normal, nullptr when normals are not loaded</param>
+	/// <param name="textureCoord">The corner texture coordinate, nullptr when they are not loaded</param>
+	/// <param name="materialID">The corner material ID, nullptr when materials are not loaded</param>
+	/// <returns>The key, every corner of a mesh must have the same attributes</returns>
+	VertexKey makeVertexKey(const glm::vec3& position, const glm::vec3* normal, const glm::vec2* textureCoord, const std::uint32_t* materialID);
+
+	/// <summary>
+	/// Merges identical triangle corners into vertices. Corners are keyed on the bit patterns of all their
+	/// attributes in a flat open addressing table, sized once for the corner count.
+	/// With tolerances the vertices are put in a uniform spatial hash grid instead, with cells twice the
+	/// position tolerance across, so a corner only compares against the vertices of at most 8 cells.
+	/// A corner joins the lowest numbered vertex in range and a vertex keeps the attributes of its first
+	/// corner, so the result only depends on the corner order.
+	/// Corners are added one at a time, so the vertex data can be written out as the vertices are found
+	/// without keeping the attributes of every corner.
+	/// Very large meshes can instead be welded by sorting the corners on a 64 bit key hash in parallel,
+	/// which numbers the vertices the same way.
+	/// The tables and the packed vertex keys keep their memory between meshes.
+	/// </summary>
+	class VertexWelder
+	{
+	public:
+		/// <summary>
+		/// How many corners ahead of the one being added the table slots should be prefetched
+		/// </summary>
+		static const size_t prefetchDistance = 16;
+
+		/// <summary>
+		/// The fewest corners for which exact welding is done by sorting on the shared pool
+		/// </summary>
+		static const size_t sortedWeldCornerCount = 1 << 22;
+
+		/// <summary>
+		/// Checks whether a mesh is worth welding with weldSorted: exact matches only, at least
+		/// sortedWeldCornerCount corners and more than one worker thread in the shared pool
+		/// </summary>
+		/// <param name="cornerCount">The number of corners in the mesh</param>
+		/// <param name="tolerances">How far apart welded corners may be</param>
+		static bool useSortedWeld(size_t cornerCount, const WeldTolerances& tolerances);
+
+		/// <summary>
+		/// Starts welding a mesh, clearing the table
+		/// </summary>
+		/// <param name="cornerCount">The most corners that will be added</param>
+		/// <param name="tolerances">How far apart welded corners may be, exact matches only by default</param>
+		void begin(size_t cornerCount, const WeldTolerances& tolerances = WeldTolerances());
+
+		/// <summary>
+		/// Fetches the table slot of a key that will be added soon into the cache
+		/// </summary>
+		/// <param name="key">The key of a later corner</param>
+		void prefetch(const VertexKey& key) const;
+
+		/// <summary>
+		/// Adds a corner, numbering the vertices in the order their first corner is added
+		/// </summary>
+		/// <param name="key">The key of the corner</param>
+		/// <param name="isNewVertex">Set to true when no earlier corner had the same key</param>
+		/// <returns>The vertex of the corner</returns>
+		std::uint32_t add(const VertexKey& key, bool& isNewVertex);
+
+		/// <summary>
+		/// Gets the number of vertices found since begin
+		/// </summary>
+		size_t getVertexCount() const { return vertexCount; }
+
+		/// <summary>
+		/// Welds the corners of a mesh with exact matching by sorting them on the shared pool.
+		/// Each corner gets a 64 bit hash of its key, the (hash, corner) pairs are radix sorted and every run
+		/// of equal hashes is split by the full keys. The vertices come out numbered in the order of their
+		/// first corner, exactly as adding the corners one at a time would number them.
+		/// </summary>
+		/// <param name="cornerCount">The number of corners</param>
+		/// <param name="getKey">Makes the key of a corner, called from several threads and more than once per corner</param>
+		/// <param name="outIndices">The vertex of each corner</param>
+		/// <param name="outVertexSources">The first corner of each vertex, to copy the vertex data from</param>
+		void weldSorted(size_t cornerCount, const std::function<VertexKey(size_t)>& getKey, std::vector<std::uint32_t>& outIndices,
+			std::vector<std::uint32_t>& outVertexSources);
+
+		/// <summary>
+		/// Frees the table
+		/// </summary>
+		void clear();
+
+	private:
+		struct Slot
+		{
+			std::uint32_t hash;
+			std::uint32_t vertex;
+		};
+
+		struct SortEntry
+		{
+			std::uint64_t hash;
+			std::uint32_t corner;
+		};
+
+		struct Cell
+		{
+			std::int64_t x;
+			std::int64_t y;
+			std::int64_t z;
+			std::uint32_t firstVertex;
+		};
+
+		std::uint32_t addToGrid(const VertexKey& key, bool& isNewVertex);
+		Cell* findCell(std::int64_t x, std::int64_t y, std::int64_t z, bool create);
+		bool isInTolerance(const VertexKey& key, std::uint32_t vertex) const;
+
+		std::vector<Slot> table;
+		size_t mask = 0;
+		std::vector<std::uint32_t> vertexKeys;		// The key of every vertex, packed
+		int keyWords = 0;
+		size_t vertexCount = 0;
+
+		// The spatial hash grid used with tolerances, each cell heads a list of the vertices in it
+		WeldTolerances tolerances;
+		bool useGrid = false;
+		double cellSize = 0.0;
+		float minNormalCosine = 1.0f;
+		std::vector<Cell> cells;
+		size_t cellMask = 0;
+		std::vector<std::uint32_t> nextInCell;
+
+		// The buffers of the sorted weld: the corners ordered by hash and the first corner with the same key as each corner
+		std::vector<SortEntry> sortEntries;
+		std::vector<SortEntry> sortScratch;
+		std::vector<std::uint32_t> firstCorners;
+	};
+}
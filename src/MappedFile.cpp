@@ -0,0 +1,135 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fbx {
+
+    MappedFile::MappedFile(const char* filename) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Failed to open the file.");
+        }
+        fileHandle = file;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) {
+            unmap();
+            throw std::runtime_error("Failed to get the file size.");
+        }
+        mappedSize = (size_t)fileSize.QuadPart;
+
+        // Empty files can not be mapped
+        if (mappedSize == 0) {
+            return;
+        }
+
+        mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL) {
+            unmap();
+            throw std::runtime_error("Failed to map the file.");
+        }
+        mappedData = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (mappedData == nullptr) {
+            unmap();
+            throw std::runtime_error("Failed to map the file.");
+        }
+        isMapped = true;
+#else
+        int file = open(filename, O_RDONLY);
+        if (file < 0) {
+            throw std::runtime_error("Failed to open the file.");
+        }
+
+        struct stat fileStatus;
+        if (fstat(file, &fileStatus) != 0) {
+            close(file);
+            throw std::runtime_error("Failed to get the file size.");
+        }
+        mappedSize = (size_t)fileStatus.st_size;
+
+        // Empty files can not be mapped
+        if (mappedSize == 0) {
+            close(file);
+            return;
+        }
+
+        void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        if (mapping == MAP_FAILED) {
+            mappedSize = 0;
+            throw std::runtime_error("Failed to map the file.");
+        }
+        mappedData = (const char*)mapping;
+        isMapped = true;
+#endif
+    }
+
+    MappedFile::MappedFile(const char* data, size_t size)
+        : mappedData(data), mappedSize(size) {
+    }
+
+    MappedFile::MappedFile(std::unique_ptr<char[]> buffer, size_t size)
+        : mappedSize(size), ownedData(std::move(buffer)) {
+        mappedData = ownedData.get();
+    }
+
+    MappedFile::~MappedFile() {
+        unmap();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            std::swap(mappedData, other.mappedData);
+            std::swap(mappedSize, other.mappedSize);
+            std::swap(isMapped, other.isMapped);
+            std::swap(ownedData, other.ownedData);
+#ifdef _WIN32
+            std::swap(fileHandle, other.fileHandle);
+            std::swap(mappingHandle, other.mappingHandle);
+#endif
+        }
+        return *this;
+    }
+
+    void MappedFile::unmap() {
+#ifdef _WIN32
+        if (isMapped && mappedData != nullptr) {
+            UnmapViewOfFile(mappedData);
+        }
+        if (mappingHandle != nullptr) {
+            CloseHandle(mappingHandle);
+        }
+        if (fileHandle != nullptr) {
+            CloseHandle(fileHandle);
+        }
+        fileHandle = nullptr;
+        mappingHandle = nullptr;
+#else
+        if (isMapped && mappedData != nullptr) {
+            munmap((void*)mappedData, mappedSize);
+        }
+#endif
+        mappedData = nullptr;
+        mappedSize = 0;
+        isMapped = false;
+        ownedData.reset();
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+
+namespace fbx {
+	/// <summary>
+	/// A read only memory mapping of a whole file. It can also stand in for a file held in memory,
+	/// either borrowing the caller's buffer or owning a buffer that was read from a stream.
+	/// </summary>
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+
+		/// <summary>
+		/// Maps the given file into memory
+		/// </summary>
+		/// <param name="filename">The file path</param>
+		explicit MappedFile(const char* filename);
+
+		/// <summary>
+		/// Views a file already in memory without copying it, the data must outlive the view
+		/// </summary>
+		/// <param name="data">The file contents</param>
+		/// <param name="size">The size of the file in bytes</param>
+		MappedFile(const char* data, size_t size);
+
+		/// <summary>
+		/// Takes ownership of a buffer holding the file contents
+		/// </summary>
+		/// <param name="buffer">The buffer, which may be larger than the file</param>
+		/// <param name="size">The size of the file in bytes</param>
+		MappedFile(std::unique_ptr<char[]> buffer, size_t size);
+
+		~MappedFile();
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* data() const { return mappedData; }
+		size_t size() const { return mappedSize; }
+
+	private:
+		void unmap();
+
+		const char* mappedData = nullptr;
+		size_t mappedSize = 0;
+
+		// Only mapped files are unmapped, borrowed data is left alone and owned data lives here
+		bool isMapped = false;
+		std::unique_ptr<char[]> ownedData;
+
+#ifdef _WIN32
+		void* fileHandle = nullptr;
+		void* mappingHandle = nullptr;
+#endif
+	};
+}
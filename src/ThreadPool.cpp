@@ -0,0 +1,115 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace fbx {
+
+    ThreadPool::ThreadPool(unsigned threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (unsigned i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { workerLoop(); });
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace(std::move(task));
+        }
+        condition.notify_one();
+    }
+
+    void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& task) {
+        if (count == 0) {
+            return;
+        }
+        if (count == 1) {
+            task(0);
+            return;
+        }
+
+        // Shared state so helpers which start late can still see it after the call returns
+        struct LoopState
+        {
+            std::atomic<size_t> next{ 0 };
+            std::atomic<size_t> finished{ 0 };
+            size_t count = 0;
+            std::function<void(size_t)> task;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        auto state = std::make_shared<LoopState>();
+        state->count = count;
+        state->task = task;
+
+        auto runTasks = [](LoopState& loop) {
+            size_t i;
+            while ((i = loop.next.fetch_add(1)) < loop.count) {
+                try {
+                    loop.task(i);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(loop.mutex);
+                    if (!loop.error) {
+                        loop.error = std::current_exception();
+                    }
+                }
+                if (loop.finished.fetch_add(1) + 1 == loop.count) {
+                    std::lock_guard<std::mutex> lock(loop.mutex);
+                    loop.done.notify_all();
+                }
+            }
+        };
+
+        // Wake up enough workers to help and take part on this thread
+        size_t helpers = std::min(count - 1, workers.size());
+        for (size_t i = 0; i < helpers; i++) {
+            submit([state, runTasks]() { runTasks(*state); });
+        }
+        runTasks(*state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&]() { return state->finished.load() == state->count; });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    ThreadPool& ThreadPool::shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    void ThreadPool::workerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace fbx {
+	/// <summary>
+	/// A fixed set of worker threads that run queued tasks
+	/// </summary>
+	class ThreadPool
+	{
+	public:
+		/// <summary>
+		/// Starts the worker threads
+		/// </summary>
+		/// <param name="threadCount">The number of workers, 0 uses the hardware concurrency</param>
+		explicit ThreadPool(unsigned threadCount = 0);
+
+		/// <summary>
+		/// Finishes the queued tasks and joins the workers
+		/// </summary>
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		/// <summary>
+		/// Queues a task to run on a worker
+		/// </summary>
+		/// <param name="task">The task to run</param>
+		void submit(std::function<void()> task);
+
+		/// <summary>
+		/// Runs task(i) for every i in [0, count) and waits for them all to finish.
+		/// The calling thread also runs tasks so it is safe to call from a worker.
+		/// The first exception thrown by a task is rethrown once all tasks have stopped.
+		/// </summary>
+		/// <param name="count">The number of tasks</param>
+		/// <param name="task">The task to run for each index</param>
+		void parallelFor(size_t count, const std::function<void(size_t)>& task);
+
+		/// <summary>
+		/// Gets the number of worker threads
+		/// </summary>
+		unsigned size() const { return (unsigned)workers.size(); }
+
+		/// <summary>
+		/// Gets the pool shared by the loader, sized to the hardware concurrency
+		/// </summary>
+		static ThreadPool& shared();
+
+	private:
+		void workerLoop();
+
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool stopping = false;
+	};
+}